@@ -0,0 +1,750 @@
+//Бенчмарк поискового сервера. Корпус и запросы генерируются детерминированно из seed, так что прогоны
+//с одинаковыми параметрами сравнимы между собой и между версиями кода.
+//Сборка: g++ -std=c++17 -O2 -I search-server benchmark/benchmark.cpp $(ls search-server/*.cpp | grep -v main.cpp) -ltbb -lpthread
+//Параметры: --имя=значение, см. PrintUsage
+#include "search_server.h"
+#include "process_queries.h"
+#include "remove_duplicates.h"
+#include "latency_histogram.h"
+#include "corpus_loader.h"
+#include "concurrent_map.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <execution>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+    using Clock = chrono::steady_clock;
+
+    struct BenchmarkOptions
+    {
+        size_t document_count = 20000;
+        size_t document_words = 50;
+        size_t query_count = 2000;
+        size_t query_words = 4;
+        double minus_rate = 0.1;                    //Доля минус-слов в запросах
+        size_t vocabulary_size = 20000;
+        string distribution = "zipf";               //uniform или zipf
+        double zipf_exponent = 1.0;
+        size_t stop_word_count = 5;                 //Самые частые слова словаря становятся стоп-словами
+        double duplicate_rate = 0.05;               //Доля документов-дубликатов для remove_duplicates
+        double remove_rate = 0.2;                   //Доля удаляемых документов для remove
+        size_t warmup = 1;
+        size_t repetitions = 5;
+        vector<size_t> threads;                     //Пусто - 1, 2, 4 ... до числа ядер
+        uint64_t seed = 42;
+        string format = "text";                     //text или json
+        vector<string> benchmarks;                  //Пусто - все
+    };
+
+    //mt19937_64 задан стандартом побитово, а распределения стандартной библиотеки - нет,
+    //поэтому числа из него превращаются в индексы и доли своим кодом
+    class Random
+    {
+    public:
+        explicit Random(uint64_t seed)
+            : generator_(seed)
+        {
+        }
+
+        double NextDouble()
+        {
+            return static_cast<double>(generator_() >> 11) * (1.0 / 9007199254740992.0);
+        }
+
+        size_t NextIndex(size_t size)
+        {
+            return static_cast<size_t>(NextDouble() * size);
+        }
+
+    private:
+        mt19937_64 generator_;
+    };
+
+    //Номер слова словаря: равномерно или по закону Ципфа (вероятность ранга r пропорциональна 1 / r^s)
+    class TermSampler
+    {
+    public:
+        TermSampler(size_t vocabulary_size, const string& distribution, double zipf_exponent)
+        {
+            if (distribution == "zipf")
+            {
+                cumulative_.resize(vocabulary_size);
+                double total = 0.0;
+                for (size_t rank = 0; rank < vocabulary_size; ++rank)
+                {
+                    total += 1.0 / pow(static_cast<double>(rank + 1), zipf_exponent);
+                    cumulative_[rank] = total;
+                }
+                for (double& value : cumulative_)
+                {
+                    value /= total;
+                }
+            }
+            else if (distribution != "uniform")
+            {
+                throw invalid_argument("Unknown distribution " + distribution);
+            }
+            vocabulary_size_ = vocabulary_size;
+        }
+
+        size_t operator()(Random& random) const
+        {
+            if (cumulative_.empty())
+            {
+                return random.NextIndex(vocabulary_size_);
+            }
+            const size_t rank = lower_bound(cumulative_.begin(), cumulative_.end(), random.NextDouble()) - cumulative_.begin();
+            return min(rank, vocabulary_size_ - 1);
+        }
+
+    private:
+        size_t vocabulary_size_ = 0;
+        vector<double> cumulative_;
+    };
+
+    //Различные слова из строчных латинских букв: номер слова в системе счисления по основанию 26
+    vector<string> GenerateVocabulary(size_t size)
+    {
+        vector<string> words;
+        words.reserve(size);
+        for (size_t i = 0; i < size; ++i)
+        {
+            string word;
+            size_t value = i;
+            do
+            {
+                word.push_back(static_cast<char>('a' + value % 26));
+                value /= 26;
+            } while (value != 0);
+            words.push_back(word + "x");
+        }
+        return words;
+    }
+
+    string GenerateText(Random& random, const vector<string>& vocabulary, const TermSampler& sampler, size_t word_count, double minus_rate)
+    {
+        string text;
+        for (size_t i = 0; i < word_count; ++i)
+        {
+            if (!text.empty())
+            {
+                text.push_back(' ');
+            }
+            if (minus_rate > 0 && random.NextDouble() < minus_rate)
+            {
+                text.push_back('-');
+            }
+            text += vocabulary[sampler(random)];
+        }
+        return text;
+    }
+
+    //Те же слова в другом порядке: дубликат для RemoveDuplicates
+    string ShuffleWords(Random& random, const string& text)
+    {
+        vector<string> words;
+        istringstream in(text);
+        for (string word; in >> word;)
+        {
+            words.push_back(word);
+        }
+        for (size_t i = words.size(); i > 1; --i)
+        {
+            swap(words[i - 1], words[random.NextIndex(i)]);
+        }
+        string result;
+        for (const string& word : words)
+        {
+            result += (result.empty() ? "" : " ") + word;
+        }
+        return result;
+    }
+
+    struct Corpus
+    {
+        string stop_words;
+        vector<string> documents;
+        vector<vector<int>> ratings;
+        vector<string> queries;
+        vector<uint64_t> counter_keys;              //Ключи для concurrent_map_add
+    };
+
+    Corpus GenerateCorpus(const BenchmarkOptions& options)
+    {
+        Random random(options.seed);
+        const vector<string> vocabulary = GenerateVocabulary(options.vocabulary_size);
+        const TermSampler sampler(options.vocabulary_size, options.distribution, options.zipf_exponent);
+
+        Corpus corpus;
+        for (size_t i = 0; i < min(options.stop_word_count, vocabulary.size()); ++i)
+        {
+            corpus.stop_words += (i == 0 ? "" : " ") + vocabulary[i];
+        }
+        for (size_t i = 0; i < options.document_count; ++i)
+        {
+            if (i > 0 && random.NextDouble() < options.duplicate_rate)
+            {
+                corpus.documents.push_back(ShuffleWords(random, corpus.documents[random.NextIndex(i)]));
+            }
+            else
+            {
+                corpus.documents.push_back(GenerateText(random, vocabulary, sampler, options.document_words, 0.0));
+            }
+            vector<int> ratings(3);
+            for (int& rating : ratings)
+            {
+                rating = static_cast<int>(random.NextIndex(10)) - 2;
+            }
+            corpus.ratings.push_back(move(ratings));
+        }
+        for (size_t i = 0; i < options.query_count; ++i)
+        {
+            corpus.queries.push_back(GenerateText(random, vocabulary, sampler, options.query_words, options.minus_rate));
+        }
+        //Номера слов с шагом 65536: ключи различаются только старшими битами, а частые слова дают горячие ключи
+        corpus.counter_keys.resize(options.document_count * options.document_words);
+        for (uint64_t& key : corpus.counter_keys)
+        {
+            key = static_cast<uint64_t>(sampler(random)) << 16;
+        }
+        return corpus;
+    }
+
+    SearchServer BuildServer(const Corpus& corpus)
+    {
+        SearchServer search_server(corpus.stop_words);
+        for (size_t i = 0; i < corpus.documents.size(); ++i)
+        {
+            search_server.AddDocument(static_cast<int>(i), corpus.documents[i], DocumentStatus::ACTUAL, corpus.ratings[i]);
+        }
+        return search_server;
+    }
+
+    struct BenchmarkResult
+    {
+        string name;
+        size_t threads = 1;
+        size_t operations = 0;                      //Операций за повтор
+        vector<double> seconds;                     //Время каждого повтора
+        LatencyHistogram latencies;                 //Задержки отдельных операций всех повторов, нс
+
+        double GetThroughput(double seconds_per_run) const
+        {
+            return seconds_per_run > 0 ? operations / seconds_per_run : 0.0;
+        }
+
+        double GetMedianSeconds() const
+        {
+            vector<double> sorted = seconds;
+            sort(sorted.begin(), sorted.end());
+            return sorted.empty() ? 0.0 : sorted[sorted.size() / 2];
+        }
+    };
+
+    //Замеряет операцию, записывающую задержку каждого своего шага в гистограмму. Прогоны разогрева не учитываются.
+    //prepare вызывается перед каждым прогоном вне замера
+    template <typename Prepare, typename Run>
+    BenchmarkResult Measure(const BenchmarkOptions& options, string name, size_t threads, size_t operations, Prepare prepare, Run run)
+    {
+        BenchmarkResult result;
+        result.name = move(name);
+        result.threads = threads;
+        result.operations = operations;
+        for (size_t i = 0; i < options.warmup + options.repetitions; ++i)
+        {
+            prepare();
+            LatencyHistogram latencies;
+            const Clock::time_point start = Clock::now();
+            run(latencies);
+            const double seconds = chrono::duration<double>(Clock::now() - start).count();
+            if (i >= options.warmup)
+            {
+                result.seconds.push_back(seconds);
+                result.latencies.Merge(latencies);
+            }
+        }
+        return result;
+    }
+
+    template <typename Function>
+    void Timed(LatencyHistogram& latencies, Function function)
+    {
+        const Clock::time_point start = Clock::now();
+        function();
+        latencies.Add(static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(Clock::now() - start).count()));
+    }
+
+    vector<size_t> GetThreadCounts(const BenchmarkOptions& options)
+    {
+        if (!options.threads.empty())
+        {
+            return options.threads;
+        }
+        vector<size_t> threads;
+        const size_t hardware_threads = max(1u, thread::hardware_concurrency());
+        for (size_t count = 1; count < hardware_threads; count *= 2)
+        {
+            threads.push_back(count);
+        }
+        threads.push_back(hardware_threads);
+        return threads;
+    }
+
+    vector<BenchmarkResult> RunBenchmarks(const BenchmarkOptions& options, const Corpus& corpus)
+    {
+        const auto enabled = [&options](string_view name)
+        {
+            return options.benchmarks.empty() || find(options.benchmarks.begin(), options.benchmarks.end(), name) != options.benchmarks.end();
+        };
+        const auto nothing = [] {};
+        const SearchServer base_server = BuildServer(corpus);
+        const vector<string>& queries = corpus.queries;
+        vector<BenchmarkResult> results;
+
+        if (enabled("add_document"))
+        {
+            results.push_back(Measure(options, "add_document", 1, corpus.documents.size(), nothing,
+                [&](LatencyHistogram& latencies)
+                {
+                    SearchServer search_server(corpus.stop_words);
+                    for (size_t i = 0; i < corpus.documents.size(); ++i)
+                    {
+                        Timed(latencies, [&] { search_server.AddDocument(static_cast<int>(i), corpus.documents[i], DocumentStatus::ACTUAL, corpus.ratings[i]); });
+                    }
+                }));
+        }
+        if (enabled("add_documents_par"))
+        {
+            vector<NewDocument> documents;
+            for (size_t i = 0; i < corpus.documents.size(); ++i)
+            {
+                documents.push_back({ static_cast<int>(i), corpus.documents[i], DocumentStatus::ACTUAL, corpus.ratings[i] });
+            }
+            results.push_back(Measure(options, "add_documents_par", 1, documents.size(), nothing,
+                [&](LatencyHistogram& latencies)
+                {
+                    SearchServer search_server(corpus.stop_words);
+                    Timed(latencies, [&] { search_server.AddDocuments(execution::par, documents); });
+                }));
+        }
+        if (enabled("load_corpus_getline") || enabled("load_corpus_seq") || enabled("load_corpus_par"))
+        {
+            const string path = (filesystem::temp_directory_path() / ("search-benchmark-" + to_string(options.seed) + ".tsv")).string();
+            {
+                string text;
+                for (size_t i = 0; i < corpus.documents.size(); ++i)
+                {
+                    AppendCorpusLine(text, static_cast<int>(i), DocumentStatus::ACTUAL, corpus.ratings[i], corpus.documents[i]);
+                }
+                ofstream(path, ios::binary) << text;
+            }
+            //Прежний путь: построчное чтение через iostream с копией текста каждого документа
+            if (enabled("load_corpus_getline"))
+            {
+                results.push_back(Measure(options, "load_corpus_getline", 1, corpus.documents.size(), nothing,
+                    [&](LatencyHistogram& latencies)
+                    {
+                        Timed(latencies,
+                            [&]
+                            {
+                                SearchServer search_server(corpus.stop_words);
+                                ifstream in(path);
+                                for (string line; getline(in, line);)
+                                {
+                                    istringstream fields(line);
+                                    string id, status, ratings, text;
+                                    getline(fields, id, '\t');
+                                    getline(fields, status, '\t');
+                                    getline(fields, ratings, '\t');
+                                    getline(fields, text);
+                                    vector<int> document_ratings;
+                                    istringstream ratings_in(ratings);
+                                    for (int rating; ratings_in >> rating;)
+                                    {
+                                        document_ratings.push_back(rating);
+                                    }
+                                    search_server.AddDocument(stoi(id), text, static_cast<DocumentStatus>(stoi(status)), document_ratings);
+                                }
+                            });
+                    }));
+            }
+            for (const bool parallel : { false, true })
+            {
+                const string name = parallel ? "load_corpus_par" : "load_corpus_seq";
+                if (!enabled(name))
+                {
+                    continue;
+                }
+                results.push_back(Measure(options, name, 1, corpus.documents.size(), nothing,
+                    [&](LatencyHistogram& latencies)
+                    {
+                        Timed(latencies,
+                            [&]
+                            {
+                                SearchServer search_server(corpus.stop_words);
+                                if (parallel)
+                                {
+                                    LoadCorpus(execution::par, search_server, path);
+                                }
+                                else
+                                {
+                                    LoadCorpus(execution::seq, search_server, path);
+                                }
+                            });
+                    }));
+            }
+            filesystem::remove(path);
+        }
+        if (enabled("find_top_documents_seq"))
+        {
+            results.push_back(Measure(options, "find_top_documents_seq", 1, queries.size(), nothing,
+                [&](LatencyHistogram& latencies)
+                {
+                    for (const string& query : queries)
+                    {
+                        Timed(latencies, [&] { base_server.FindTopDocuments(execution::seq, query); });
+                    }
+                }));
+        }
+        if (enabled("find_top_documents_par"))
+        {
+            results.push_back(Measure(options, "find_top_documents_par", 1, queries.size(), nothing,
+                [&](LatencyHistogram& latencies)
+                {
+                    for (const string& query : queries)
+                    {
+                        Timed(latencies, [&] { base_server.FindTopDocuments(execution::par, query); });
+                    }
+                }));
+        }
+        if (enabled("find_top_documents_concurrent"))
+        {
+            //Масштабирование: запросы делятся между потоками-клиентами, каждый ищет последовательно
+            for (size_t thread_count : GetThreadCounts(options))
+            {
+                results.push_back(Measure(options, "find_top_documents_concurrent", thread_count, queries.size(), nothing,
+                    [&](LatencyHistogram& latencies)
+                    {
+                        vector<thread> clients;
+                        for (size_t client = 0; client < thread_count; ++client)
+                        {
+                            clients.emplace_back(
+                                [&, client]
+                                {
+                                    for (size_t i = client; i < queries.size(); i += thread_count)
+                                    {
+                                        Timed(latencies, [&] { base_server.FindTopDocuments(queries[i]); });
+                                    }
+                                });
+                        }
+                        for (thread& client : clients)
+                        {
+                            client.join();
+                        }
+                    }));
+            }
+        }
+        if (enabled("match_document_seq") || enabled("match_document_par"))
+        {
+            for (const bool parallel : { false, true })
+            {
+                const string name = parallel ? "match_document_par" : "match_document_seq";
+                if (!enabled(name))
+                {
+                    continue;
+                }
+                results.push_back(Measure(options, name, 1, queries.size(), nothing,
+                    [&](LatencyHistogram& latencies)
+                    {
+                        for (size_t i = 0; i < queries.size(); ++i)
+                        {
+                            const int document_id = static_cast<int>(i % corpus.documents.size());
+                            if (parallel)
+                            {
+                                Timed(latencies, [&] { base_server.MatchDocument(execution::par, queries[i], document_id); });
+                            }
+                            else
+                            {
+                                Timed(latencies, [&] { base_server.MatchDocument(execution::seq, queries[i], document_id); });
+                            }
+                        }
+                    }));
+            }
+        }
+        if (enabled("remove_document"))
+        {
+            const size_t step = options.remove_rate > 0 ? max<size_t>(1, static_cast<size_t>(1.0 / options.remove_rate)) : corpus.documents.size() + 1;
+            SearchServer search_server;
+            results.push_back(Measure(options, "remove_document", 1, (corpus.documents.size() + step - 1) / step,
+                [&] { search_server = base_server; },
+                [&](LatencyHistogram& latencies)
+                {
+                    for (size_t id = 0; id < corpus.documents.size(); id += step)
+                    {
+                        Timed(latencies, [&] { search_server.RemoveDocument(static_cast<int>(id)); });
+                    }
+                }));
+        }
+        if (enabled("remove_duplicates"))
+        {
+            SearchServer search_server;
+            results.push_back(Measure(options, "remove_duplicates", 1, corpus.documents.size(),
+                [&] { search_server = base_server; },
+                [&](LatencyHistogram& latencies)
+                {
+                    //RemoveDuplicates печатает найденные дубликаты, вывод бенчмарка от этого страдать не должен
+                    ostringstream sink;
+                    streambuf* const original = cout.rdbuf(sink.rdbuf());
+                    Timed(latencies, [&] { RemoveDuplicates(search_server); });
+                    cout.rdbuf(original);
+                }));
+        }
+        if (enabled("process_queries"))
+        {
+            results.push_back(Measure(options, "process_queries", 1, queries.size(), nothing,
+                [&](LatencyHistogram& latencies)
+                {
+                    Timed(latencies, [&] { ProcessQueries(base_server, queries); });
+                }));
+        }
+        if (enabled("concurrent_map_add"))
+        {
+            //Потоки-клиенты считают ключи в общем словаре вперемешку, как при параллельном подсчёте частот.
+            //Часы читаются на пачку сложений, чтобы не замерять в основном их
+            const size_t BATCH_SIZE = 256;
+            const vector<uint64_t>& keys = corpus.counter_keys;
+            for (size_t thread_count : GetThreadCounts(options))
+            {
+                unique_ptr<ConcurrentMap<uint64_t, int64_t>> counters;
+                results.push_back(Measure(options, "concurrent_map_add", thread_count, keys.size(),
+                    [&] { counters = make_unique<ConcurrentMap<uint64_t, int64_t>>(options.vocabulary_size); },
+                    [&](LatencyHistogram& latencies)
+                    {
+                        vector<thread> clients;
+                        for (size_t client = 0; client < thread_count; ++client)
+                        {
+                            clients.emplace_back(
+                                [&, client]
+                                {
+                                    for (size_t begin = client * BATCH_SIZE; begin < keys.size(); begin += thread_count * BATCH_SIZE)
+                                    {
+                                        const size_t end = min(keys.size(), begin + BATCH_SIZE);
+                                        Timed(latencies,
+                                            [&]
+                                            {
+                                                for (size_t i = begin; i < end; ++i)
+                                                {
+                                                    counters->Add(keys[i], 1);
+                                                }
+                                            });
+                                    }
+                                });
+                        }
+                        for (thread& client : clients)
+                        {
+                            client.join();
+                        }
+                    }));
+            }
+        }
+        return results;
+    }
+
+    void PrintText(ostream& out, const vector<BenchmarkResult>& results)
+    {
+        out << "benchmark                       threads     ops/s(median)   p50,us   p99,us  p999,us   max,us\n";
+        for (const BenchmarkResult& result : results)
+        {
+            char line[256];
+            snprintf(line, sizeof(line), "%-31s %7zu %17.1f %8.1f %8.1f %8.1f %8.1f\n",
+                result.name.c_str(), result.threads, result.GetThroughput(result.GetMedianSeconds()),
+                result.latencies.GetPercentile(0.5) / 1000.0, result.latencies.GetPercentile(0.99) / 1000.0,
+                result.latencies.GetPercentile(0.999) / 1000.0, result.latencies.GetMax() / 1000.0);
+            out << line;
+        }
+    }
+
+    void PrintJson(ostream& out, const BenchmarkOptions& options, const vector<BenchmarkResult>& results)
+    {
+        out << "{\"config\":{"
+            << "\"documents\":" << options.document_count
+            << ",\"document_words\":" << options.document_words
+            << ",\"queries\":" << options.query_count
+            << ",\"query_words\":" << options.query_words
+            << ",\"minus_rate\":" << options.minus_rate
+            << ",\"vocabulary\":" << options.vocabulary_size
+            << ",\"distribution\":\"" << options.distribution << '"'
+            << ",\"zipf_exponent\":" << options.zipf_exponent
+            << ",\"stop_words\":" << options.stop_word_count
+            << ",\"duplicate_rate\":" << options.duplicate_rate
+            << ",\"remove_rate\":" << options.remove_rate
+            << ",\"warmup\":" << options.warmup
+            << ",\"repetitions\":" << options.repetitions
+            << ",\"seed\":" << options.seed
+            << ",\"hardware_threads\":" << thread::hardware_concurrency()
+            << "},\"results\":[";
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            const BenchmarkResult& result = results[i];
+            out << (i == 0 ? "" : ",") << "{\"name\":\"" << result.name << '"'
+                << ",\"threads\":" << result.threads
+                << ",\"operations\":" << result.operations
+                << ",\"seconds\":[";
+            for (size_t run = 0; run < result.seconds.size(); ++run)
+            {
+                out << (run == 0 ? "" : ",") << result.seconds[run];
+            }
+            out << "],\"throughput_median\":" << result.GetThroughput(result.GetMedianSeconds())
+                << ",\"latency_ns\":{\"p50\":" << result.latencies.GetPercentile(0.5)
+                << ",\"p99\":" << result.latencies.GetPercentile(0.99)
+                << ",\"p999\":" << result.latencies.GetPercentile(0.999)
+                << ",\"max\":" << result.latencies.GetMax() << "}}";
+        }
+        out << "]}\n";
+    }
+
+    void PrintUsage(ostream& out)
+    {
+        out << "Usage: benchmark [--name=value]...\n"
+            << "  --documents, --document-words, --queries, --query-words, --minus-rate, --vocabulary,\n"
+            << "  --distribution=uniform|zipf, --zipf-exponent, --stop-words, --duplicate-rate, --remove-rate,\n"
+            << "  --warmup, --repetitions, --threads=1,2,4, --seed, --format=text|json,\n"
+            << "  --benchmarks=add_document,add_documents_par,load_corpus_getline,load_corpus_seq,load_corpus_par,\n"
+            << "               find_top_documents_seq,find_top_documents_par,\n"
+            << "               find_top_documents_concurrent,match_document_seq,match_document_par,\n"
+            << "               remove_document,remove_duplicates,process_queries,concurrent_map_add\n";
+    }
+
+    vector<string> SplitList(const string& value)
+    {
+        vector<string> items;
+        istringstream in(value);
+        for (string item; getline(in, item, ',');)
+        {
+            if (!item.empty())
+            {
+                items.push_back(item);
+            }
+        }
+        return items;
+    }
+
+    BenchmarkOptions ParseOptions(int argc, char** argv)
+    {
+        BenchmarkOptions options;
+        const map<string, size_t*> sizes = {
+            { "documents", &options.document_count }, { "document-words", &options.document_words },
+            { "queries", &options.query_count }, { "query-words", &options.query_words },
+            { "vocabulary", &options.vocabulary_size }, { "stop-words", &options.stop_word_count },
+            { "warmup", &options.warmup }, { "repetitions", &options.repetitions }
+        };
+        const map<string, double*> rates = {
+            { "minus-rate", &options.minus_rate }, { "zipf-exponent", &options.zipf_exponent },
+            { "duplicate-rate", &options.duplicate_rate }, { "remove-rate", &options.remove_rate }
+        };
+        for (int i = 1; i < argc; ++i)
+        {
+            const string argument = argv[i];
+            const size_t equals = argument.find('=');
+            if (argument.rfind("--", 0) != 0 || equals == string::npos)
+            {
+                throw invalid_argument("Bad argument " + argument);
+            }
+            const string name = argument.substr(2, equals - 2);
+            const string value = argument.substr(equals + 1);
+            if (const auto it = sizes.find(name); it != sizes.end())
+            {
+                *it->second = stoul(value);
+            }
+            else if (const auto it = rates.find(name); it != rates.end())
+            {
+                *it->second = stod(value);
+            }
+            else if (name == "distribution")
+            {
+                options.distribution = value;
+            }
+            else if (name == "seed")
+            {
+                options.seed = stoull(value);
+            }
+            else if (name == "format")
+            {
+                options.format = value;
+            }
+            else if (name == "threads")
+            {
+                for (const string& item : SplitList(value))
+                {
+                    options.threads.push_back(stoul(item));
+                }
+            }
+            else if (name == "benchmarks")
+            {
+                options.benchmarks = SplitList(value);
+            }
+            else
+            {
+                throw invalid_argument("Unknown option " + name);
+            }
+        }
+        if (options.vocabulary_size == 0 || options.document_count == 0 || options.repetitions == 0)
+        {
+            throw invalid_argument("vocabulary, documents and repetitions must be positive");
+        }
+        if (options.distribution != "uniform" && options.distribution != "zipf")
+        {
+            throw invalid_argument("Unknown distribution " + options.distribution);
+        }
+        if (options.format != "text" && options.format != "json")
+        {
+            throw invalid_argument("Unknown format " + options.format);
+        }
+        return options;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    BenchmarkOptions options;
+    try
+    {
+        options = ParseOptions(argc, argv);
+    }
+    catch (const exception& e)
+    {
+        cerr << e.what() << '\n';
+        PrintUsage(cerr);
+        return 1;
+    }
+
+    const Corpus corpus = GenerateCorpus(options);
+    const vector<BenchmarkResult> results = RunBenchmarks(options, corpus);
+    if (options.format == "json")
+    {
+        PrintJson(cout, options, results);
+    }
+    else
+    {
+        PrintText(cout, results);
+    }
+    return 0;
+}
@@ -0,0 +1,49 @@
+#include "batch_results.h"
+
+using namespace std;
+
+BatchResults::BatchResults()
+    : offsets_{ 0 }
+{
+}
+
+BatchResults::BatchResults(vector<Document> documents, vector<size_t> offsets)
+    : documents_(move(documents))
+    , offsets_(move(offsets))
+{
+}
+
+void BatchResults::Reserve(size_t query_count, size_t document_count)
+{
+    offsets_.reserve(query_count + 1);
+    documents_.reserve(document_count);
+}
+
+void BatchResults::Append(Range documents)
+{
+    documents_.insert(documents_.end(), documents.begin(), documents.end());
+    offsets_.push_back(documents_.size());
+}
+
+size_t BatchResults::size() const
+{
+    return offsets_.size() - 1;
+}
+
+BatchResults::Range BatchResults::operator[](size_t query_index) const
+{
+    return Range(documents_.begin() + offsets_[query_index], documents_.begin() + offsets_[query_index + 1]);
+}
+
+BatchResults::Range BatchResults::GetJoined() const
+{
+    return Range(documents_.begin(), documents_.end());
+}
+
+vector<Document> BatchResults::ExtractJoined()
+{
+    vector<Document> documents = move(documents_);
+    documents_.clear();
+    offsets_.assign(1, 0);
+    return documents;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include "document.h"
+#include "paginator.h"
+#include <vector>
+#include <cstddef>
+
+//Выдача пачки запросов: документы всех запросов лежат подряд в одном буфере,
+//документы запроса i занимают [offsets_[i], offsets_[i + 1])
+class BatchResults
+{
+public:
+    using Range = IteratorRange<std::vector<Document>::const_iterator>;
+
+    BatchResults();
+
+    //Выдача из готового буфера: документы запроса i занимают [offsets[i], offsets[i + 1]), offsets[0] == 0
+    BatchResults(std::vector<Document> documents, std::vector<size_t> offsets);
+
+    void Reserve(size_t query_count, size_t document_count);
+
+    //Дописывает выдачу следующего запроса
+    void Append(Range documents);
+
+    //Число запросов
+    size_t size() const;
+
+    //Документы запроса, без копирования
+    Range operator[](size_t query_index) const;
+
+    //Документы всех запросов подряд в порядке запросов, без копирования
+    Range GetJoined() const;
+
+    //Забирает буфер со всеми документами подряд
+    std::vector<Document> ExtractJoined();
+
+private:
+    std::vector<Document> documents_;
+    std::vector<size_t> offsets_;
+};
@@ -0,0 +1,133 @@
+#include "block_max_scorer.h"
+#include <algorithm>
+#include <functional>
+
+using namespace std;
+
+const double BlockMaxScorer::PRUNING_MARGIN = 2 * EPSILON;
+
+void BlockMaxScorer::Reset(const PostingIndex& index, const vector<pair<int, double>>& plus_terms,
+    const vector<int>& minus_terms, int first_ordinal, int last_ordinal)
+{
+    //Курсоры перенимают буферы прошлых запросов, поэтому списки только добавляются
+    if (lists_.size() < plus_terms.size())
+    {
+        lists_.resize(plus_terms.size());
+    }
+    list_count_ = 0;
+    for (const auto& [term, inverse_document_freq] : plus_terms)
+    {
+        List& list = lists_[list_count_++];
+        list.blocks.Open(index, term, first_ordinal);
+        list.tail.OpenTail(index, term, first_ordinal);
+        list.inverse_document_freq = inverse_document_freq;
+        list.max_relevance = max(list.blocks.GetMaxTermFreq(), list.tail.GetMaxTermFreq()) * inverse_document_freq;
+    }
+    by_bound_.clear();
+    for (size_t list = 0; list < list_count_; ++list)
+    {
+        if (lists_[list].GetOrdinal() < last_ordinal)
+        {
+            by_bound_.push_back(list);
+        }
+    }
+    sort(by_bound_.begin(), by_bound_.end(),
+        [this](size_t lhs, size_t rhs)
+        {
+            return lists_[lhs].max_relevance < lists_[rhs].max_relevance;
+        });
+    prefix_bounds_.clear();
+    ordinals_.clear();
+    for (size_t list : by_bound_)
+    {
+        prefix_bounds_.push_back((prefix_bounds_.empty() ? 0.0 : prefix_bounds_.back()) + lists_[list].max_relevance);
+        ordinals_.push_back(lists_[list].GetOrdinal());
+    }
+
+    if (minus_cursors_.size() < minus_terms.size() * 2)
+    {
+        minus_cursors_.resize(minus_terms.size() * 2);
+    }
+    minus_cursor_count_ = 0;
+    for (const int term : minus_terms)
+    {
+        minus_cursors_[minus_cursor_count_++].Open(index, term, first_ordinal);
+        minus_cursors_[minus_cursor_count_++].OpenTail(index, term, first_ordinal);
+    }
+    last_ordinal_ = last_ordinal;
+}
+
+bool BlockMaxScorer::IsExcluded(int ordinal)
+{
+    for (size_t i = 0; i < minus_cursor_count_; ++i)
+    {
+        minus_cursors_[i].Seek(ordinal);
+        if (minus_cursors_[i].GetOrdinal() == ordinal)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void BlockMaxScorer::AddCandidate(int ordinal, size_t top_k)
+{
+    //Вклады складываются в том же порядке, что и при полном подсчёте
+    Candidate candidate{ list_count_ * 2, ordinal, 0.0 };
+    for (size_t i = 0; i < list_count_; ++i)
+    {
+        const List& list = lists_[i];
+        if (list.GetOrdinal() == ordinal)
+        {
+            candidate.list = min(candidate.list, i * 2 + (list.IsInTail() ? 1 : 0));
+            candidate.relevance += list.GetTermFreq() * list.inverse_document_freq;
+        }
+    }
+    if (candidate.relevance < threshold_)
+    {
+        return;
+    }
+    candidates_.push_back(candidate);
+
+    if (top_relevances_.size() < top_k)
+    {
+        top_relevances_.push_back(candidate.relevance);
+        push_heap(top_relevances_.begin(), top_relevances_.end(), greater<double>());
+    }
+    else if (candidate.relevance > top_relevances_.front())
+    {
+        pop_heap(top_relevances_.begin(), top_relevances_.end(), greater<double>());
+        top_relevances_.back() = candidate.relevance;
+        push_heap(top_relevances_.begin(), top_relevances_.end(), greater<double>());
+    }
+    if (top_relevances_.size() == top_k)
+    {
+        threshold_ = top_relevances_.front() - PRUNING_MARGIN;
+    }
+
+    if (candidates_.size() >= compaction_size_)
+    {
+        candidates_.erase(remove_if(candidates_.begin(), candidates_.end(),
+            [this](const Candidate& candidate)
+            {
+                return candidate.relevance < threshold_;
+            }),
+            candidates_.end());
+        compaction_size_ = max(MIN_COMPACTION_SIZE, candidates_.size() * 2);
+    }
+}
+
+void BlockMaxScorer::FinishCandidates()
+{
+    candidates_.erase(remove_if(candidates_.begin(), candidates_.end(),
+        [this](const Candidate& candidate)
+        {
+            return candidate.relevance < threshold_;
+        }),
+        candidates_.end());
+    sort(candidates_.begin(), candidates_.end(),
+        [](const Candidate& lhs, const Candidate& rhs)
+        {
+            return lhs.list != rhs.list ? lhs.list < rhs.list : lhs.ordinal < rhs.ordinal;
+        });
+}
@@ -0,0 +1,262 @@
+#pragma once
+#include <vector>
+#include <utility>
+#include <limits>
+#include <cstddef>
+#include "posting_index.h"
+#include "top_documents.h"
+
+//Отбор лучших документов обходом документ за документом с отсечением по наибольшим вкладам слов (MaxScore
+//с оценками по блокам). Порог - релевантность худшего из top_k лучших уже посчитанных документов. Списки слов,
+//которые все вместе не дотягивают до порога, несущественны: кандидаты берутся только из остальных списков,
+//а в несущественных кандидат ищется, только если без них оценка сверху ещё дотягивает до порога. Оценки
+//уточняются наибольшими TF блоков, в которых лежит документ, и целые блоки перескакиваются без распаковки.
+//Выдача совпадает с полным подсчётом: документ отсекается, только если он хуже top_k посчитанных больше чем
+//на EPSILON, то есть проигрывает каждому из них и при сравнении с допуском. Релевантность складывается по словам
+//в порядке запроса, а прошедшие отсечение документы отдаются в порядке первого касания при полном подсчёте
+class BlockMaxScorer
+{
+public:
+    //Запас отсечения: EPSILON для сравнения с допуском и столько же на погрешность сумм в другом порядке
+    static const double PRUNING_MARGIN;
+
+    //Готовит обход документов с номерами [first_ordinal, last_ordinal). plus_terms - id слов и их IDF (не отрицательные)
+    void Reset(const PostingIndex& index, const std::vector<std::pair<int, double>>& plus_terms,
+        const std::vector<int>& minus_terms, int first_ordinal, int last_ordinal);
+
+    //Считает подходящие под accept документы без минус-слов, которые могут войти в top_k лучших
+    template <typename Accept>
+    void Score(size_t top_k, Accept accept)
+    {
+        candidates_.clear();
+        top_relevances_.clear();
+        threshold_ = std::numeric_limits<double>::lowest();
+        if (top_k == 0)
+        {
+            return;
+        }
+        compaction_size_ = MIN_COMPACTION_SIZE;
+
+        size_t essential = 0;
+        UpdateEssential(essential);
+        //Оценка по блокам, в которых лежат документы до block_last_ordinal во всех существенных списках
+        double block_bound = 0.0;
+        int block_last_ordinal = -1;
+        while (true)
+        {
+            //Кандидаты - только документы из существенных списков: без них документ не дотянет до порога
+            int ordinal = PostingIndex::Cursor::END;
+            for (size_t i = essential; i < by_bound_.size(); ++i)
+            {
+                ordinal = std::min(ordinal, ordinals_[i]);
+            }
+            if (ordinal >= last_ordinal_)
+            {
+                break;
+            }
+
+            //Если порога не достичь и с наибольшими вкладами блоков, списки перескакивают за ближайший конец блока
+            if (ordinal > block_last_ordinal)
+            {
+                block_bound = essential > 0 ? prefix_bounds_[essential - 1] : 0.0;
+                block_last_ordinal = PostingIndex::Cursor::END;
+                for (size_t i = essential; i < by_bound_.size(); ++i)
+                {
+                    List& list = lists_[by_bound_[i]];
+                    list.SeekBlock(ordinal);
+                    block_bound += list.GetBlockMaxTermFreq() * list.inverse_document_freq;
+                    block_last_ordinal = std::min(block_last_ordinal, list.GetBlockLastOrdinal());
+                }
+            }
+            if (block_bound < threshold_)
+            {
+                for (size_t i = essential; i < by_bound_.size(); ++i)
+                {
+                    if (ordinals_[i] <= block_last_ordinal)
+                    {
+                        List& list = lists_[by_bound_[i]];
+                        list.Seek(block_last_ordinal + 1);
+                        ordinals_[i] = list.GetOrdinal();
+                    }
+                }
+                continue;
+            }
+
+            double bound = essential > 0 ? prefix_bounds_[essential - 1] : 0.0;
+            for (size_t i = essential; i < by_bound_.size(); ++i)
+            {
+                if (ordinals_[i] == ordinal)
+                {
+                    const List& list = lists_[by_bound_[i]];
+                    bound += list.GetTermFreq() * list.inverse_document_freq;
+                }
+            }
+            //Документ с минус-словом отбрасывается до уточнения оценки
+            if (bound >= threshold_ && !IsExcluded(ordinal))
+            {
+                //Несущественные списки уточняют оценку сначала наибольшими вкладами блоков, без распаковки,
+                //затем настоящими вкладами, от списков с большими вкладами к меньшим
+                for (size_t i = essential; i-- > 0 && bound >= threshold_;)
+                {
+                    List& list = lists_[by_bound_[i]];
+                    bound -= list.max_relevance;
+                    if (list.GetOrdinal() <= ordinal)
+                    {
+                        list.SeekBlock(ordinal);
+                        bound += list.GetBlockMaxTermFreq() * list.inverse_document_freq;
+                    }
+                }
+                for (size_t i = essential; i-- > 0 && bound >= threshold_;)
+                {
+                    List& list = lists_[by_bound_[i]];
+                    if (list.GetOrdinal() <= ordinal)
+                    {
+                        bound -= list.GetBlockMaxTermFreq() * list.inverse_document_freq;
+                        list.Seek(ordinal);
+                        if (list.GetOrdinal() == ordinal)
+                        {
+                            bound += list.GetTermFreq() * list.inverse_document_freq;
+                        }
+                    }
+                }
+                if (bound >= threshold_ && accept(ordinal))
+                {
+                    AddCandidate(ordinal, top_k);
+                    //Оценка по блокам учитывала списки, которые теперь несущественны, только наибольшими вкладами блоков
+                    const size_t previous_essential = essential;
+                    UpdateEssential(essential);
+                    if (essential != previous_essential)
+                    {
+                        block_last_ordinal = -1;
+                    }
+                }
+            }
+
+            for (size_t i = essential; i < by_bound_.size(); ++i)
+            {
+                if (ordinals_[i] == ordinal)
+                {
+                    List& list = lists_[by_bound_[i]];
+                    list.Next();
+                    ordinals_[i] = list.GetOrdinal();
+                }
+            }
+        }
+
+        FinishCandidates();
+    }
+
+    //Обходит посчитанные документы в порядке первого касания при полном подсчёте (по слову, затем по номеру),
+    //как ScoreAccumulator::ForEachDocument
+    template <typename Function>
+    void ForEachDocument(Function function) const
+    {
+        for (const Candidate& candidate : candidates_)
+        {
+            function(candidate.ordinal, candidate.relevance);
+        }
+    }
+
+private:
+    //Кандидаты чистятся от отставших от порога, когда их становится больше этого и вдвое больше, чем после прошлой чистки
+    static constexpr size_t MIN_COMPACTION_SIZE = 1024;
+
+    //Вхождения одного плюс-слова: слитые блоки и хвост. Документ есть не больше чем в одном из них, поэтому
+    //оценки списка - наибольшие из оценок блоков и хвоста, а не их суммы
+    struct List
+    {
+        PostingIndex::Cursor blocks;
+        PostingIndex::Cursor tail;
+        double inverse_document_freq = 0.0;
+        double max_relevance = 0.0;                 //Наибольший вклад вхождения списка
+
+        int GetOrdinal() const
+        {
+            return std::min(blocks.GetOrdinal(), tail.GetOrdinal());
+        }
+
+        bool IsInTail() const
+        {
+            return tail.GetOrdinal() < blocks.GetOrdinal();
+        }
+
+        double GetTermFreq() const
+        {
+            return IsInTail() ? tail.GetTermFreq() : blocks.GetTermFreq();
+        }
+
+        void Next()
+        {
+            if (IsInTail())
+            {
+                tail.Next();
+            }
+            else
+            {
+                blocks.Next();
+            }
+        }
+
+        void Seek(int ordinal)
+        {
+            blocks.Seek(ordinal);
+            tail.Seek(ordinal);
+        }
+
+        void SeekBlock(int ordinal)
+        {
+            blocks.SeekBlock(ordinal);
+            tail.SeekBlock(ordinal);
+        }
+
+        int GetBlockLastOrdinal() const
+        {
+            return std::min(blocks.GetBlockLastOrdinal(), tail.GetBlockLastOrdinal());
+        }
+
+        double GetBlockMaxTermFreq() const
+        {
+            return std::max(blocks.GetBlockMaxTermFreq(), tail.GetBlockMaxTermFreq());
+        }
+    };
+
+    //Посчитанный документ. list - первый список полного подсчёта с этим документом (2 * слово, у хвоста
+    //на 1 больше), по нему восстанавливается порядок полного подсчёта
+    struct Candidate
+    {
+        size_t list = 0;
+        int ordinal = 0;
+        double relevance = 0.0;
+    };
+
+    std::vector<List> lists_;                       //По словам запроса
+    size_t list_count_ = 0;                         //lists_ только растёт, чтобы курсоры сохраняли буферы
+    std::vector<size_t> by_bound_;                  //Номера непустых списков по возрастанию наибольшего вклада
+    std::vector<double> prefix_bounds_;             //Сумма наибольших вкладов by_bound_[0..i]
+    std::vector<int> ordinals_;                     //Текущий номер курсора by_bound_[i]. Для несущественных списков не ведётся
+    std::vector<PostingIndex::Cursor> minus_cursors_;
+    size_t minus_cursor_count_ = 0;
+    int last_ordinal_ = 0;
+    std::vector<Candidate> candidates_;
+    std::vector<double> top_relevances_;            //Куча top_k лучших релевантностей, на вершине - худшая
+    double threshold_ = 0.0;                        //Худшая из top_k лучших релевантностей минус PRUNING_MARGIN
+    size_t compaction_size_ = MIN_COMPACTION_SIZE;
+
+    //Сдвигает границу существенных списков: списки by_bound_ до неё все вместе не дотягивают до порога
+    void UpdateEssential(size_t& essential) const
+    {
+        while (essential < by_bound_.size() && prefix_bounds_[essential] < threshold_)
+        {
+            ++essential;
+        }
+    }
+
+    //Есть ли в документе минус-слово. Документы проверяются по возрастанию номера
+    bool IsExcluded(int ordinal);
+
+    //Считает релевантность документа, на котором стоят курсоры, и при необходимости поднимает порог
+    void AddCandidate(int ordinal, size_t top_k);
+
+    //Убирает кандидатов ниже порога и упорядочивает остальных по порядку полного подсчёта
+    void FinishCandidates();
+};
@@ -0,0 +1,294 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <iterator>
+#include <algorithm>
+#include <cstddef>
+
+class MappedFile;
+
+//Массив из кусков по CHUNK_SIZE элементов, которые делятся между копиями: копия стоит O(size / CHUNK_SIZE)
+//счётчиков ссылок, а изменение элемента копирует только его кусок, если тот общий с другой копией или лежит
+//в отображённом файле (копирование при записи). Для таблиц, которые меняются по одному элементу: копия индекса,
+//сделанная ради одного изменения, не копирует их целиком. Элементы одного куска лежат подряд
+template <typename T>
+class ChunkedArray
+{
+public:
+    static constexpr size_t CHUNK_BITS = 10;
+    static constexpr size_t CHUNK_SIZE = size_t(1) << CHUNK_BITS;
+
+    class const_iterator
+    {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T*;
+        using reference = const T&;
+
+        const_iterator() = default;
+
+        const_iterator(const ChunkedArray* array, size_t index)
+            : array_(array)
+            , index_(index)
+        {
+        }
+
+        reference operator*() const
+        {
+            return (*array_)[index_];
+        }
+
+        pointer operator->() const
+        {
+            return &(*array_)[index_];
+        }
+
+        reference operator[](difference_type offset) const
+        {
+            return (*array_)[index_ + offset];
+        }
+
+        const_iterator& operator++()
+        {
+            ++index_;
+            return *this;
+        }
+
+        const_iterator operator++(int)
+        {
+            const_iterator result = *this;
+            ++index_;
+            return result;
+        }
+
+        const_iterator& operator--()
+        {
+            --index_;
+            return *this;
+        }
+
+        const_iterator operator--(int)
+        {
+            const_iterator result = *this;
+            --index_;
+            return result;
+        }
+
+        const_iterator& operator+=(difference_type offset)
+        {
+            index_ += offset;
+            return *this;
+        }
+
+        const_iterator& operator-=(difference_type offset)
+        {
+            index_ -= offset;
+            return *this;
+        }
+
+        const_iterator operator+(difference_type offset) const
+        {
+            return const_iterator(array_, index_ + offset);
+        }
+
+        friend const_iterator operator+(difference_type offset, const const_iterator& it)
+        {
+            return it + offset;
+        }
+
+        const_iterator operator-(difference_type offset) const
+        {
+            return const_iterator(array_, index_ - offset);
+        }
+
+        difference_type operator-(const const_iterator& other) const
+        {
+            return static_cast<difference_type>(index_) - static_cast<difference_type>(other.index_);
+        }
+
+        bool operator==(const const_iterator& other) const
+        {
+            return index_ == other.index_;
+        }
+
+        bool operator!=(const const_iterator& other) const
+        {
+            return index_ != other.index_;
+        }
+
+        bool operator<(const const_iterator& other) const
+        {
+            return index_ < other.index_;
+        }
+
+        bool operator>(const const_iterator& other) const
+        {
+            return index_ > other.index_;
+        }
+
+        bool operator<=(const const_iterator& other) const
+        {
+            return index_ <= other.index_;
+        }
+
+        bool operator>=(const const_iterator& other) const
+        {
+            return index_ >= other.index_;
+        }
+
+    private:
+        const ChunkedArray* array_ = nullptr;
+        size_t index_ = 0;
+    };
+
+    ChunkedArray() = default;
+
+    explicit ChunkedArray(size_t size, const T& value = T())
+    {
+        resize(size, value);
+    }
+
+    ChunkedArray(const std::vector<T>& values)
+    {
+        for (size_t begin = 0; begin < values.size(); begin += CHUNK_SIZE)
+        {
+            const size_t count = std::min(CHUNK_SIZE, values.size() - begin);
+            T* chunk = AddChunk();
+            std::copy(values.begin() + begin, values.begin() + begin + count, chunk);
+            size_ += count;
+        }
+    }
+
+    //Элементы, лежащие в отображённом файле: куски смотрят в него и держат файл открытым
+    ChunkedArray(const std::shared_ptr<const MappedFile>& file, const T* data, size_t size)
+        : size_(size)
+    {
+        for (size_t begin = 0; begin < size; begin += CHUNK_SIZE)
+        {
+            chunks_.push_back({ std::shared_ptr<const T[]>(file, data + begin), true });
+        }
+    }
+
+    size_t size() const
+    {
+        return size_;
+    }
+
+    bool empty() const
+    {
+        return size_ == 0;
+    }
+
+    const T& operator[](size_t index) const
+    {
+        return chunks_[index >> CHUNK_BITS].data[index & (CHUNK_SIZE - 1)];
+    }
+
+    const T& back() const
+    {
+        return (*this)[size_ - 1];
+    }
+
+    const_iterator begin() const
+    {
+        return const_iterator(this, 0);
+    }
+
+    const_iterator end() const
+    {
+        return const_iterator(this, size_);
+    }
+
+    //Элемент для изменения. Его кусок при необходимости сначала копируется
+    T& GetMutable(size_t index)
+    {
+        return GetOwnedChunk(index >> CHUNK_BITS)[index & (CHUNK_SIZE - 1)];
+    }
+
+    void push_back(T value)
+    {
+        if ((size_ & (CHUNK_SIZE - 1)) == 0)
+        {
+            AddChunk()[0] = std::move(value);
+        }
+        else
+        {
+            GetOwnedChunk(size_ >> CHUNK_BITS)[size_ & (CHUNK_SIZE - 1)] = std::move(value);
+        }
+        ++size_;
+    }
+
+    void resize(size_t size, const T& value = T())
+    {
+        if (size < size_)
+        {
+            chunks_.resize((size + CHUNK_SIZE - 1) >> CHUNK_BITS);
+            size_ = size;
+            return;
+        }
+        while (size_ < size)
+        {
+            push_back(value);
+        }
+    }
+
+    void assign(size_t size, const T& value)
+    {
+        clear();
+        resize(size, value);
+    }
+
+    void clear()
+    {
+        chunks_.clear();
+        size_ = 0;
+    }
+
+    //Вызывает function(const T* data, size_t count) для кусков элементов [begin, end) по порядку
+    template <typename Function>
+    void ForEachRange(size_t begin, size_t end, Function function) const
+    {
+        while (begin < end)
+        {
+            const size_t count = std::min(end, ((begin >> CHUNK_BITS) + 1) << CHUNK_BITS) - begin;
+            function(&(*this)[begin], count);
+            begin += count;
+        }
+    }
+
+private:
+    struct Chunk
+    {
+        std::shared_ptr<const T[]> data;
+        bool is_mapped = false;
+    };
+
+    std::vector<Chunk> chunks_;
+    size_t size_ = 0;
+
+    T* AddChunk()
+    {
+        std::shared_ptr<T[]> data(new T[CHUNK_SIZE]);
+        T* result = data.get();
+        chunks_.push_back({ std::move(data), false });
+        return result;
+    }
+
+    T* GetOwnedChunk(size_t index)
+    {
+        Chunk& chunk = chunks_[index];
+        if (chunk.is_mapped || chunk.data.use_count() > 1)
+        {
+            std::shared_ptr<T[]> data(new T[CHUNK_SIZE]);
+            const size_t count = std::min(CHUNK_SIZE, size_ - (index << CHUNK_BITS));
+            std::copy(chunk.data.get(), chunk.data.get() + count, data.get());
+            chunk = { std::move(data), false };
+        }
+        //Если последняя чужая копия куска только что уничтожена в другом потоке, её чтения должны закончиться до наших записей
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return const_cast<T*>(chunk.data.get());
+    }
+};
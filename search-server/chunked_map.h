@@ -0,0 +1,331 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <iterator>
+#include <algorithm>
+#include <utility>
+#include <stdexcept>
+#include <cstddef>
+
+//Упорядоченный словарь из отсортированных кусков до MAX_CHUNK_SIZE элементов, которые делятся между копиями,
+//как куски ChunkedArray: копия стоит O(size / MAX_CHUNK_SIZE), вставка и удаление копируют один кусок.
+//Поиск - двоичный по первым ключам кусков, затем внутри куска
+template <typename Key, typename Value>
+class ChunkedMap
+{
+public:
+    static constexpr size_t MAX_CHUNK_SIZE = 1024;
+
+    using Item = std::pair<Key, Value>;
+
+    class const_iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Item;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Item*;
+        using reference = const Item&;
+
+        const_iterator() = default;
+
+        const_iterator(const ChunkedMap* map, size_t chunk, size_t position)
+            : map_(map)
+            , chunk_(chunk)
+            , position_(position)
+        {
+        }
+
+        reference operator*() const
+        {
+            return (*map_->chunks_[chunk_])[position_];
+        }
+
+        pointer operator->() const
+        {
+            return &**this;
+        }
+
+        const_iterator& operator++()
+        {
+            if (++position_ == map_->chunks_[chunk_]->size())
+            {
+                ++chunk_;
+                position_ = 0;
+            }
+            return *this;
+        }
+
+        const_iterator operator++(int)
+        {
+            const_iterator result = *this;
+            ++*this;
+            return result;
+        }
+
+        bool operator==(const const_iterator& other) const
+        {
+            return chunk_ == other.chunk_ && position_ == other.position_;
+        }
+
+        bool operator!=(const const_iterator& other) const
+        {
+            return !(*this == other);
+        }
+
+    private:
+        const ChunkedMap* map_ = nullptr;
+        size_t chunk_ = 0;
+        size_t position_ = 0;
+    };
+
+    //Обход одних ключей, по возрастанию
+    class key_iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Key;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Key*;
+        using reference = const Key&;
+
+        key_iterator() = default;
+
+        explicit key_iterator(const_iterator it)
+            : it_(it)
+        {
+        }
+
+        reference operator*() const
+        {
+            return it_->first;
+        }
+
+        pointer operator->() const
+        {
+            return &it_->first;
+        }
+
+        key_iterator& operator++()
+        {
+            ++it_;
+            return *this;
+        }
+
+        key_iterator operator++(int)
+        {
+            key_iterator result = *this;
+            ++it_;
+            return result;
+        }
+
+        bool operator==(const key_iterator& other) const
+        {
+            return it_ == other.it_;
+        }
+
+        bool operator!=(const key_iterator& other) const
+        {
+            return it_ != other.it_;
+        }
+
+    private:
+        const_iterator it_;
+    };
+
+    ChunkedMap() = default;
+
+    //Словарь из элементов, упорядоченных по возрастанию ключа без повторов
+    explicit ChunkedMap(std::vector<Item> sorted_items)
+    {
+        for (size_t begin = 0; begin < sorted_items.size(); begin += MAX_CHUNK_SIZE)
+        {
+            const size_t end = std::min(sorted_items.size(), begin + MAX_CHUNK_SIZE);
+            chunks_.push_back(std::make_shared<std::vector<Item>>(
+                std::make_move_iterator(sorted_items.begin() + begin), std::make_move_iterator(sorted_items.begin() + end)));
+            first_keys_.push_back(chunks_.back()->front().first);
+        }
+        size_ = sorted_items.size();
+    }
+
+    size_t size() const
+    {
+        return size_;
+    }
+
+    bool empty() const
+    {
+        return size_ == 0;
+    }
+
+    const_iterator begin() const
+    {
+        return const_iterator(this, 0, 0);
+    }
+
+    const_iterator end() const
+    {
+        return const_iterator(this, chunks_.size(), 0);
+    }
+
+    key_iterator key_begin() const
+    {
+        return key_iterator(begin());
+    }
+
+    key_iterator key_end() const
+    {
+        return key_iterator(end());
+    }
+
+    const_iterator find(const Key& key) const
+    {
+        const size_t chunk = FindChunk(key);
+        if (chunk != chunks_.size())
+        {
+            const std::vector<Item>& items = *chunks_[chunk];
+            const auto it = LowerBound(items, key);
+            if (it != items.end() && it->first == key)
+            {
+                return const_iterator(this, chunk, it - items.begin());
+            }
+        }
+        return end();
+    }
+
+    size_t count(const Key& key) const
+    {
+        return find(key) == end() ? 0 : 1;
+    }
+
+    const Value& at(const Key& key) const
+    {
+        const const_iterator it = find(key);
+        if (it == end())
+        {
+            throw std::out_of_range("ChunkedMap::at");
+        }
+        return it->second;
+    }
+
+    //Значение для изменения или nullptr, если ключа нет. Кусок при необходимости сначала копируется
+    Value* FindMutable(const Key& key)
+    {
+        const size_t chunk = FindChunk(key);
+        if (chunk == chunks_.size())
+        {
+            return nullptr;
+        }
+        const size_t position = LowerBound(*chunks_[chunk], key) - chunks_[chunk]->begin();
+        if (position == chunks_[chunk]->size() || (*chunks_[chunk])[position].first != key)
+        {
+            return nullptr;
+        }
+        return &GetOwnedChunk(chunk)[position].second;
+    }
+
+    //false, если ключ уже есть
+    bool Insert(const Key& key, Value value)
+    {
+        if (chunks_.empty())
+        {
+            chunks_.push_back(std::make_shared<std::vector<Item>>());
+            first_keys_.push_back(key);
+        }
+        //Ключ меньше всех попадает в первый кусок
+        size_t chunk = FindChunk(key);
+        if (chunk == chunks_.size())
+        {
+            chunk = 0;
+        }
+        const size_t position = LowerBound(*chunks_[chunk], key) - chunks_[chunk]->begin();
+        if (position < chunks_[chunk]->size() && (*chunks_[chunk])[position].first == key)
+        {
+            return false;
+        }
+
+        //Ключи обычно растут: за полным последним куском начинается новый, а не делится пополам
+        if (chunk + 1 == chunks_.size() && position == chunks_[chunk]->size() && position == MAX_CHUNK_SIZE)
+        {
+            chunks_.push_back(std::make_shared<std::vector<Item>>(1, Item(key, std::move(value))));
+            first_keys_.push_back(key);
+            ++size_;
+            return true;
+        }
+
+        std::vector<Item>& items = GetOwnedChunk(chunk);
+        items.insert(items.begin() + position, Item(key, std::move(value)));
+        first_keys_[chunk] = items.front().first;
+        if (items.size() > MAX_CHUNK_SIZE)
+        {
+            auto upper = std::make_shared<std::vector<Item>>(
+                std::make_move_iterator(items.begin() + items.size() / 2), std::make_move_iterator(items.end()));
+            items.resize(items.size() / 2);
+            first_keys_.insert(first_keys_.begin() + chunk + 1, upper->front().first);
+            chunks_.insert(chunks_.begin() + chunk + 1, std::move(upper));
+        }
+        ++size_;
+        return true;
+    }
+
+    //false, если ключа нет
+    bool Erase(const Key& key)
+    {
+        const size_t chunk = FindChunk(key);
+        if (chunk == chunks_.size())
+        {
+            return false;
+        }
+        const size_t position = LowerBound(*chunks_[chunk], key) - chunks_[chunk]->begin();
+        if (position == chunks_[chunk]->size() || (*chunks_[chunk])[position].first != key)
+        {
+            return false;
+        }
+        if (chunks_[chunk]->size() == 1)
+        {
+            chunks_.erase(chunks_.begin() + chunk);
+            first_keys_.erase(first_keys_.begin() + chunk);
+        }
+        else
+        {
+            std::vector<Item>& items = GetOwnedChunk(chunk);
+            items.erase(items.begin() + position);
+            first_keys_[chunk] = items.front().first;
+        }
+        --size_;
+        return true;
+    }
+
+private:
+    std::vector<std::shared_ptr<const std::vector<Item>>> chunks_;    //Непустые, ключи растут от куска к куску
+    std::vector<Key> first_keys_;                                       //Первый ключ каждого куска
+    size_t size_ = 0;
+
+    //Кусок, в котором должен лежать ключ, или chunks_.size(), если ключ меньше всех
+    size_t FindChunk(const Key& key) const
+    {
+        const size_t next = std::upper_bound(first_keys_.begin(), first_keys_.end(), key) - first_keys_.begin();
+        return next == 0 ? chunks_.size() : next - 1;
+    }
+
+    static typename std::vector<Item>::const_iterator LowerBound(const std::vector<Item>& items, const Key& key)
+    {
+        return std::lower_bound(items.begin(), items.end(), key,
+            [](const Item& item, const Key& key)
+            {
+                return item.first < key;
+            });
+    }
+
+    std::vector<Item>& GetOwnedChunk(size_t chunk)
+    {
+        if (chunks_[chunk].use_count() > 1)
+        {
+            chunks_[chunk] = std::make_shared<std::vector<Item>>(*chunks_[chunk]);
+        }
+        //Если последняя чужая копия куска только что уничтожена в другом потоке, её чтения должны закончиться до наших записей
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return const_cast<std::vector<Item>&>(*chunks_[chunk]);
+    }
+};
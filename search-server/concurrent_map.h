@@ -1,47 +1,334 @@
 #pragma once
 #include <vector>
 #include <map>
-#include <future>
+#include <memory>
+#include <atomic>
+#include <shared_mutex>
+#include <mutex>
+#include <thread>
 #include <algorithm>
+#include <numeric>
+#include <execution>
+#include <functional>
+#include <optional>
+#include <type_traits>
+#include <cstdint>
 
-template <typename Key, typename Value>
+//Конкурентный словарь на открытой адресации. Ключи распределены по шардам, каждый шард выровнен по кэш-линии.
+//Значения хранятся в std::atomic и обновляются без блокировок: вставка ключа занимает слот через CAS,
+//сложение и Update - атомарные операции над значением. Разделяемая блокировка шарда берётся только
+//ради того, чтобы шард не перестроили во время обращения, исключительная - только при росте шарда.
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
 class ConcurrentMap
 {
 public:
-    static_assert(std::is_integral_v<Key>, "ConcurrentMap supports only integer keys");
+    static_assert(std::is_trivially_copyable_v<Key>, "ConcurrentMap supports only trivially copyable keys");
+    static_assert(std::is_trivially_copyable_v<Value>, "ConcurrentMap supports only trivially copyable values");
 
-    struct Access
+    //expected_size - ожидаемое число ключей, shard_count - число шардов (0 - по числу потоков)
+    explicit ConcurrentMap(size_t expected_size = 0, size_t shard_count = 0)
     {
-        std::lock_guard<std::mutex> guard;
-        Value& ref_to_value;
-    };
+        if (shard_count == 0)
+        {
+            shard_count = std::max(1u, std::thread::hardware_concurrency()) * 4;
+        }
+        shard_bits_ = 0;
+        while ((size_t(1) << shard_bits_) < shard_count)
+        {
+            ++shard_bits_;
+        }
+        shards_ = std::vector<Shard>(size_t(1) << shard_bits_);
+
+        const size_t shard_capacity = RoundUpToPowerOfTwo(std::max<size_t>(MIN_SHARD_CAPACITY, expected_size * 2 / shards_.size() + 1));
+        for (Shard& shard : shards_)
+        {
+            shard.Allocate(shard_capacity);
+        }
+    }
+
+    //Атомарно прибавляет delta к значению ключа (отсутствующий ключ получает значение Value{})
+    void Add(const Key& key, Value delta)
+    {
+        static_assert(std::is_arithmetic_v<Value>, "Add requires an arithmetic value type");
+        if constexpr (std::is_integral_v<Value>)
+        {
+            Modify(key, [delta](std::atomic<Value>& value) { value.fetch_add(delta, std::memory_order_relaxed); });
+        }
+        else
+        {
+            Update(key, [delta](Value value) { return value + delta; });
+        }
+    }
 
-    explicit ConcurrentMap(size_t bucket_count)
-        :bucket_count_(bucket_count)
-        , maps(bucket_count)
-        , mutex_values(bucket_count)
+    //Атомарно заменяет значение ключа на function(старое значение)
+    template <typename Function>
+    void Update(const Key& key, Function function)
     {
+        Modify(key,
+            [&function](std::atomic<Value>& value)
+            {
+                Value expected = value.load(std::memory_order_relaxed);
+                while (!value.compare_exchange_weak(expected, function(expected), std::memory_order_relaxed))
+                {
+                }
+            });
     }
 
-    Access operator[](const Key& key)
+    std::optional<Value> Find(const Key& key) const
     {
-        int map_num = static_cast<uint64_t>(key) % bucket_count_;
-        return { std::lock_guard(mutex_values[map_num]), maps[map_num][key] };
+        const uint64_t hash = MixHash(key);
+        const Shard& shard = GetShard(hash);
+        std::shared_lock guard(shard.mutex);
+        const size_t mask = shard.capacity - 1;
+        for (size_t probe = 0, index = hash & mask; probe < shard.capacity; ++probe, index = (index + 1) & mask)
+        {
+            const Slot& slot = shard.slots[index];
+            uint8_t state = slot.state.load(std::memory_order_acquire);
+            while (state == BUSY)
+            {
+                std::this_thread::yield();
+                state = slot.state.load(std::memory_order_acquire);
+            }
+            if (state == EMPTY)
+            {
+                break;
+            }
+            if (slot.key == key)
+            {
+                return slot.value.load(std::memory_order_relaxed);
+            }
+        }
+        return std::nullopt;
     }
 
-    std::map<Key, Value> BuildOrdinaryMap()
+    size_t GetSize() const
     {
-        std::map<Key, Value> result_map;
-        for (size_t i = 0; i != bucket_count_; ++i)
+        size_t size = 0;
+        for (const Shard& shard : shards_)
         {
-            std::lock_guard guard(mutex_values[i]);
-            result_map.insert(maps[i].begin(), maps[i].end());
+            size += shard.size.load(std::memory_order_relaxed);
         }
-        return result_map;
+        return size;
+    }
+
+    //Удаляет все ключи, ёмкость шардов сохраняется. Нельзя вызывать одновременно с другими методами
+    void Clear()
+    {
+        for (Shard& shard : shards_)
+        {
+            for (size_t index = 0; index < shard.capacity; ++index)
+            {
+                shard.slots[index].state.store(EMPTY, std::memory_order_relaxed);
+            }
+            shard.size.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    //Выгружает содержимое в один вектор: шарды копируются параллельно, каждый в свой заранее
+    //вычисленный участок результата. При sorted результат упорядочен по ключу. Шарды на время выгрузки
+    //блокируются исключительно: вставка под разделяемой блокировкой могла бы добавить ключ после того,
+    //как размер шарда прочитан, и копирование вышло бы за его участок
+    template <typename ExecutionPolicy>
+    std::vector<std::pair<Key, Value>> Extract(ExecutionPolicy&& policy, bool sorted = false) const
+    {
+        std::vector<std::unique_lock<std::shared_mutex>> guards;
+        guards.reserve(shards_.size());
+        std::vector<size_t> offsets(shards_.size() + 1, 0);
+        for (size_t i = 0; i < shards_.size(); ++i)
+        {
+            guards.emplace_back(shards_[i].mutex);
+            offsets[i + 1] = offsets[i] + shards_[i].size.load(std::memory_order_acquire);
+        }
+
+        std::vector<std::pair<Key, Value>> result(offsets.back());
+        std::vector<size_t> shard_indexes(shards_.size());
+        std::iota(shard_indexes.begin(), shard_indexes.end(), 0);
+        std::for_each(
+            policy,
+            shard_indexes.begin(), shard_indexes.end(),
+            [&](size_t i)
+            {
+                const Shard& shard = shards_[i];
+                auto out = result.begin() + offsets[i];
+                for (size_t index = 0; index < shard.capacity; ++index)
+                {
+                    const Slot& slot = shard.slots[index];
+                    if (slot.state.load(std::memory_order_acquire) == FULL)
+                    {
+                        *out++ = { slot.key, slot.value.load(std::memory_order_relaxed) };
+                    }
+                }
+            });
+
+        if (sorted)
+        {
+            std::sort(policy, result.begin(), result.end(),
+                [](const auto& lhs, const auto& rhs)
+                {
+                    return lhs.first < rhs.first;
+                });
+        }
+        return result;
+    }
+
+    std::map<Key, Value> BuildOrdinaryMap() const
+    {
+        const auto items = Extract(std::execution::par, true);
+        return std::map<Key, Value>(items.begin(), items.end());
     }
 
 private:
-    size_t bucket_count_;
-    std::vector<std::map<Key, Value>> maps;
-    std::vector<std::mutex> mutex_values;
-};
\ No newline at end of file
+    static const uint8_t EMPTY = 0;
+    static const uint8_t BUSY = 1;     //Слот занят вставкой, ключ ещё записывается
+    static const uint8_t FULL = 2;
+    static const size_t MIN_SHARD_CAPACITY = 16;
+
+    struct Slot
+    {
+        std::atomic<uint8_t> state{ EMPTY };
+        Key key{};
+        std::atomic<Value> value{};
+    };
+
+    struct alignas(64) Shard
+    {
+        mutable std::shared_mutex mutex;
+        std::unique_ptr<Slot[]> slots;
+        size_t capacity = 0;
+        std::atomic<size_t> size{ 0 };
+
+        void Allocate(size_t new_capacity)
+        {
+            slots = std::make_unique<Slot[]>(new_capacity);
+            capacity = new_capacity;
+        }
+    };
+
+    std::vector<Shard> shards_;
+    size_t shard_bits_ = 0;
+    Hash hasher_;
+
+    static size_t RoundUpToPowerOfTwo(size_t value)
+    {
+        size_t result = 1;
+        while (result < value)
+        {
+            result <<= 1;
+        }
+        return result;
+    }
+
+    //Финализатор fmix64, как в SearchServer::ComputeFingerprint: std::hash целых - тождество, а после одного
+    //умножения младшие биты слота зависели бы только от младших битов ключа, и ключи с шагом 2^k сходились бы в один слот
+    uint64_t MixHash(const Key& key) const
+    {
+        uint64_t hash = static_cast<uint64_t>(hasher_(key));
+        hash ^= hash >> 33;
+        hash *= 0xff51afd7ed558ccdull;
+        hash ^= hash >> 33;
+        hash *= 0xc4ceb9fe1a85ec53ull;
+        hash ^= hash >> 33;
+        return hash;
+    }
+
+    //Шард выбирается по старшим битам хеша, слот внутри шарда - по младшим
+    const Shard& GetShard(uint64_t hash) const
+    {
+        return shards_[shard_bits_ == 0 ? 0 : hash >> (64 - shard_bits_)];
+    }
+
+    Shard& GetShard(uint64_t hash)
+    {
+        return shards_[shard_bits_ == 0 ? 0 : hash >> (64 - shard_bits_)];
+    }
+
+    //Находит или вставляет ключ и вызывает modify для его атомарного значения
+    template <typename Modifier>
+    void Modify(const Key& key, Modifier modify)
+    {
+        const uint64_t hash = MixHash(key);
+        Shard& shard = GetShard(hash);
+        while (true)
+        {
+            {
+                std::shared_lock guard(shard.mutex);
+                if (shard.size.load(std::memory_order_relaxed) * 4 < shard.capacity * 3)
+                {
+                    if (std::atomic<Value>* value = FindOrInsert(shard, key, hash))
+                    {
+                        modify(*value);
+                        return;
+                    }
+                }
+            }
+            Grow(shard);
+        }
+    }
+
+    //Возвращает nullptr, если свободного слота не нашлось
+    std::atomic<Value>* FindOrInsert(Shard& shard, const Key& key, uint64_t hash)
+    {
+        const size_t mask = shard.capacity - 1;
+        for (size_t probe = 0, index = hash & mask; probe < shard.capacity; )
+        {
+            Slot& slot = shard.slots[index];
+            uint8_t state = slot.state.load(std::memory_order_acquire);
+            if (state == EMPTY)
+            {
+                if (!slot.state.compare_exchange_strong(state, BUSY, std::memory_order_acquire))
+                {
+                    continue;
+                }
+                slot.key = key;
+                slot.value.store(Value{}, std::memory_order_relaxed);
+                //Размер растёт раньше, чем слот становится виден: размер шарда не бывает меньше числа видимых ключей
+                shard.size.fetch_add(1, std::memory_order_relaxed);
+                slot.state.store(FULL, std::memory_order_release);
+                return &slot.value;
+            }
+            if (state == BUSY)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            if (slot.key == key)
+            {
+                return &slot.value;
+            }
+            ++probe;
+            index = (index + 1) & mask;
+        }
+        return nullptr;
+    }
+
+    void Grow(Shard& shard)
+    {
+        std::unique_lock guard(shard.mutex);
+        if (shard.size.load(std::memory_order_relaxed) * 4 < shard.capacity * 3)
+        {
+            return;
+        }
+
+        std::unique_ptr<Slot[]> old_slots = std::move(shard.slots);
+        const size_t old_capacity = shard.capacity;
+        shard.Allocate(old_capacity * 2);
+        const size_t mask = shard.capacity - 1;
+        for (size_t old_index = 0; old_index < old_capacity; ++old_index)
+        {
+            const Slot& old_slot = old_slots[old_index];
+            if (old_slot.state.load(std::memory_order_relaxed) != FULL)
+            {
+                continue;
+            }
+            size_t index = MixHash(old_slot.key) & mask;
+            while (shard.slots[index].state.load(std::memory_order_relaxed) != EMPTY)
+            {
+                index = (index + 1) & mask;
+            }
+            Slot& slot = shard.slots[index];
+            slot.key = old_slot.key;
+            slot.value.store(old_slot.value.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            slot.state.store(FULL, std::memory_order_relaxed);
+        }
+    }
+};
@@ -0,0 +1,202 @@
+#include "corpus_loader.h"
+#include "snapshot.h"
+
+#include <algorithm>
+#include <charconv>
+
+using namespace std;
+
+namespace
+{
+    const size_t CHUNK_SIZE = 1 << 20;              //Кусок файла, который разбирается одной задачей
+    const size_t WINDOW_CHUNK_COUNT = 64;           //Кусков на один вызов AddDocuments: ограничивает память под разобранные документы
+    const size_t FIELD_COUNT = 4;
+
+    //Разобранный кусок. Номера строк считаются от начала куска, к номерам файла их приводит LoadCorpusImpl
+    struct ParsedChunk
+    {
+        vector<NewDocument> documents;
+        vector<size_t> document_lines;
+        vector<CorpusLoadError> errors;
+        size_t line_count = 0;
+    };
+
+    bool ParseInt(string_view text, int& value)
+    {
+        const auto [end, error] = from_chars(text.data(), text.data() + text.size(), value);
+        return error == errc() && end == text.data() + text.size();
+    }
+
+    //Поле до разделителя, text сдвигается за разделитель. Без разделителя возвращает весь остаток
+    string_view NextField(string_view& text, char separator)
+    {
+        const size_t end = text.find(separator);
+        const string_view field = text.substr(0, end);
+        text.remove_prefix(end == string_view::npos ? text.size() : end + 1);
+        return field;
+    }
+
+    void ParseLine(string_view line, size_t line_number, ParsedChunk& chunk)
+    {
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.remove_suffix(1);
+        }
+        if (line.empty())
+        {
+            return;
+        }
+        if (count(line.begin(), line.end(), '\t') < static_cast<ptrdiff_t>(FIELD_COUNT - 1))
+        {
+            chunk.errors.push_back({ line_number, "expected id, status, ratings and text separated by tabs" });
+            return;
+        }
+
+        NewDocument document;
+        int status = 0;
+        if (!ParseInt(NextField(line, '\t'), document.id))
+        {
+            chunk.errors.push_back({ line_number, "invalid document id" });
+            return;
+        }
+        if (!ParseInt(NextField(line, '\t'), status) || status < static_cast<int>(DocumentStatus::ACTUAL) || status > static_cast<int>(DocumentStatus::REMOVED))
+        {
+            chunk.errors.push_back({ line_number, "invalid document status" });
+            return;
+        }
+        document.status = static_cast<DocumentStatus>(status);
+        for (string_view ratings = NextField(line, '\t'); !ratings.empty();)
+        {
+            const string_view rating = NextField(ratings, ' ');
+            if (rating.empty())
+            {
+                continue;
+            }
+            int value = 0;
+            if (!ParseInt(rating, value))
+            {
+                chunk.errors.push_back({ line_number, "invalid rating" });
+                return;
+            }
+            document.ratings.push_back(value);
+        }
+        document.text = line;
+        chunk.documents.push_back(move(document));
+        chunk.document_lines.push_back(line_number);
+    }
+
+    ParsedChunk ParseChunk(string_view text)
+    {
+        ParsedChunk chunk;
+        while (!text.empty())
+        {
+            ++chunk.line_count;
+            ParseLine(NextField(text, '\n'), chunk.line_count, chunk);
+        }
+        return chunk;
+    }
+
+    //Куски примерно по CHUNK_SIZE байт, каждый заканчивается переводом строки или концом файла
+    vector<string_view> SplitIntoChunks(string_view data)
+    {
+        vector<string_view> chunks;
+        while (!data.empty())
+        {
+            size_t end = data.size();
+            if (data.size() > CHUNK_SIZE)
+            {
+                const size_t line_end = data.find('\n', CHUNK_SIZE - 1);
+                end = line_end == string_view::npos ? data.size() : line_end + 1;
+            }
+            chunks.push_back(data.substr(0, end));
+            data.remove_prefix(end);
+        }
+        return chunks;
+    }
+
+    template <typename ExecutionPolicy>
+    CorpusLoadResult LoadCorpusImpl(ExecutionPolicy policy, SearchServer& search_server, const string& path)
+    {
+        //Тексты документов смотрят в отображение, оно живёт до конца загрузки
+        const MappedFile file(path);
+        const vector<string_view> chunks = SplitIntoChunks(string_view(file.GetData(), file.GetSize()));
+
+        CorpusLoadResult result;
+        size_t lines_before = 0;
+        vector<ParsedChunk> parsed;
+        vector<NewDocument> documents;
+        vector<size_t> document_lines;
+        for (size_t begin = 0; begin < chunks.size(); begin += WINDOW_CHUNK_COUNT)
+        {
+            const size_t end = min(chunks.size(), begin + WINDOW_CHUNK_COUNT);
+            parsed.resize(end - begin);
+            transform(policy, chunks.begin() + begin, chunks.begin() + end, parsed.begin(), ParseChunk);
+
+            documents.clear();
+            document_lines.clear();
+            for (ParsedChunk& chunk : parsed)
+            {
+                move(chunk.documents.begin(), chunk.documents.end(), back_inserter(documents));
+                for (size_t line : chunk.document_lines)
+                {
+                    document_lines.push_back(lines_before + line);
+                }
+                for (CorpusLoadError& error : chunk.errors)
+                {
+                    error.line += lines_before;
+                    result.errors.push_back(move(error));
+                }
+                lines_before += chunk.line_count;
+            }
+
+            const vector<AddDocumentError> add_errors = search_server.AddDocuments(policy, documents);
+            for (const AddDocumentError& error : add_errors)
+            {
+                result.errors.push_back({ document_lines[error.index], "document " + to_string(error.document_id) + ": " + error.message });
+            }
+            result.document_count += documents.size() - add_errors.size();
+        }
+
+        //Ошибки разбора и добавления одного окна идут вперемешку
+        stable_sort(result.errors.begin(), result.errors.end(),
+            [](const CorpusLoadError& lhs, const CorpusLoadError& rhs)
+            {
+                return lhs.line < rhs.line;
+            });
+        return result;
+    }
+}
+
+CorpusLoadResult LoadCorpus(SearchServer& search_server, const string& path)
+{
+    return LoadCorpus(execution::seq, search_server, path);
+}
+
+CorpusLoadResult LoadCorpus(execution::sequenced_policy policy, SearchServer& search_server, const string& path)
+{
+    return LoadCorpusImpl(policy, search_server, path);
+}
+
+CorpusLoadResult LoadCorpus(execution::parallel_policy policy, SearchServer& search_server, const string& path)
+{
+    return LoadCorpusImpl(policy, search_server, path);
+}
+
+void AppendCorpusLine(string& out, int document_id, DocumentStatus status, const vector<int>& ratings, string_view text)
+{
+    out += to_string(document_id);
+    out += '\t';
+    out += to_string(static_cast<int>(status));
+    out += '\t';
+    for (size_t i = 0; i < ratings.size(); ++i)
+    {
+        if (i > 0)
+        {
+            out += ' ';
+        }
+        out += to_string(ratings[i]);
+    }
+    out += '\t';
+    out += text;
+    out += '\n';
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include "search_server.h"
+
+#include <execution>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//Строка файла корпуса, которую не удалось загрузить
+struct CorpusLoadError
+{
+    size_t line = 0;                                //Номер строки, с 1
+    std::string message;
+};
+
+struct CorpusLoadResult
+{
+    size_t document_count = 0;                      //Добавлено документов
+    std::vector<CorpusLoadError> errors;            //По порядку строк
+};
+
+//Загружает корпус из файла: по документу на строку, поля разделены табуляцией -
+//id, статус (число DocumentStatus), оценки через пробел, текст. Пустые строки пропускаются.
+//Файл отображается в память и режется на куски по границам строк, куски разбираются независимо,
+//тексты передаются в AddDocuments как string_view прямо в отображение, без копирования.
+//Ошибочные строки не прерывают загрузку, а попадают в errors
+CorpusLoadResult LoadCorpus(SearchServer& search_server, const std::string& path);
+CorpusLoadResult LoadCorpus(std::execution::sequenced_policy policy, SearchServer& search_server, const std::string& path);
+CorpusLoadResult LoadCorpus(std::execution::parallel_policy policy, SearchServer& search_server, const std::string& path);
+
+//Дописывает документ в формате LoadCorpus. Текст не должен содержать табуляций и переводов строк
+void AppendCorpusLine(std::string& out, int document_id, DocumentStatus status, const std::vector<int>& ratings, std::string_view text);
@@ -0,0 +1,166 @@
+#include "forward_index.h"
+#include <algorithm>
+#include <numeric>
+
+using namespace std;
+
+ForwardIndex::ForwardIndex(const SnapshotReader& reader, size_t term_count)
+    : offsets_(reader.GetChunkedSection<uint64_t>(SnapshotSection::FORWARD_OFFSETS))
+    , lengths_(reader.GetChunkedSection<uint32_t>(SnapshotSection::FORWARD_LENGTHS))
+    , terms_(reader.GetChunkedSection<int32_t>(SnapshotSection::FORWARD_TERMS))
+    , term_freqs_(reader.GetChunkedSection<double>(SnapshotSection::FORWARD_TERM_FREQS))
+{
+    if (lengths_.size() != offsets_.size() || term_freqs_.size() != terms_.size())
+    {
+        throw invalid_argument("Invalid snapshot: forward index arrays don't match");
+    }
+    for (size_t ordinal = 0; ordinal < offsets_.size(); ++ordinal)
+    {
+        if (offsets_[ordinal] > terms_.size() || lengths_[ordinal] > terms_.size() - offsets_[ordinal])
+        {
+            throw invalid_argument("Invalid snapshot: document words out of bounds");
+        }
+        //По id слов обращаются к словарю и счётчикам документов слов без проверок
+        int64_t previous_term = -1;
+        ForEachTerm(static_cast<int>(ordinal),
+            [&](int term, double term_freq)
+            {
+                if (term <= previous_term || static_cast<size_t>(term) >= term_count)
+                {
+                    throw invalid_argument("Invalid snapshot: bad document word id");
+                }
+                if (!(term_freq > 0.0 && term_freq <= 1.0))
+                {
+                    throw invalid_argument("Invalid snapshot: bad document word frequency");
+                }
+                previous_term = term;
+            });
+    }
+}
+
+void ForwardIndex::Save(SnapshotWriter& writer, const vector<int>& new_ordinals) const
+{
+    vector<int> kept;
+    vector<uint64_t> offsets;
+    vector<uint32_t> lengths;
+    ComputeCompactLayout(new_ordinals, kept, offsets, lengths);
+    offsets.pop_back();
+
+    writer.WriteSection(SnapshotSection::FORWARD_OFFSETS, offsets.data(), offsets.size());
+    writer.WriteSection(SnapshotSection::FORWARD_LENGTHS, lengths.data(), lengths.size());
+    const auto append = [&writer](const auto* data, size_t count)
+    {
+        writer.Append(data, count);
+    };
+    writer.BeginSection(SnapshotSection::FORWARD_TERMS);
+    for (const int ordinal : kept)
+    {
+        terms_.ForEachRange(offsets_[ordinal], offsets_[ordinal] + lengths_[ordinal], append);
+    }
+    writer.BeginSection(SnapshotSection::FORWARD_TERM_FREQS);
+    for (const int ordinal : kept)
+    {
+        term_freqs_.ForEachRange(offsets_[ordinal], offsets_[ordinal] + lengths_[ordinal], append);
+    }
+}
+
+void ForwardIndex::Add(vector<pair<int, double>> term_freqs)
+{
+    sort(term_freqs.begin(), term_freqs.end());
+    offsets_.push_back(terms_.size());
+    lengths_.push_back(static_cast<uint32_t>(term_freqs.size()));
+    for (const auto& [term, term_freq] : term_freqs)
+    {
+        terms_.push_back(term);
+        term_freqs_.push_back(term_freq);
+    }
+}
+
+void ForwardIndex::Remove(int ordinal)
+{
+    lengths_.GetMutable(ordinal) = 0;
+}
+
+void ForwardIndex::Compact(execution::sequenced_policy policy, const vector<int>& new_ordinals)
+{
+    CompactImpl(policy, new_ordinals);
+}
+
+void ForwardIndex::Compact(execution::parallel_policy policy, const vector<int>& new_ordinals)
+{
+    CompactImpl(policy, new_ordinals);
+}
+
+void ForwardIndex::ComputeCompactLayout(const vector<int>& new_ordinals, vector<int>& kept,
+    vector<uint64_t>& offsets, vector<uint32_t>& lengths) const
+{
+    for (size_t ordinal = 0; ordinal < offsets_.size(); ++ordinal)
+    {
+        if (new_ordinals[ordinal] != -1)
+        {
+            kept.push_back(static_cast<int>(ordinal));
+        }
+    }
+
+    offsets.assign(kept.size() + 1, 0);
+    lengths.resize(kept.size());
+    for (size_t i = 0; i < kept.size(); ++i)
+    {
+        lengths[i] = lengths_[kept[i]];
+        offsets[i + 1] = offsets[i] + lengths[i];
+    }
+}
+
+template <typename ExecutionPolicy>
+void ForwardIndex::CompactImpl(ExecutionPolicy policy, const vector<int>& new_ordinals)
+{
+    vector<int> kept;
+    vector<uint64_t> new_offsets;
+    vector<uint32_t> new_lengths;
+    ComputeCompactLayout(new_ordinals, kept, new_offsets, new_lengths);
+
+    //Каждый документ копируется в свой заранее вычисленный участок
+    vector<int32_t> new_terms(new_offsets.back());
+    vector<double> new_term_freqs(new_offsets.back());
+    vector<size_t> indexes(kept.size());
+    iota(indexes.begin(), indexes.end(), 0);
+    for_each(
+        policy,
+        indexes.begin(), indexes.end(),
+        [&](size_t i)
+        {
+            const size_t begin = offsets_[kept[i]];
+            copy(terms_.begin() + begin, terms_.begin() + begin + new_lengths[i], new_terms.begin() + new_offsets[i]);
+            copy(term_freqs_.begin() + begin, term_freqs_.begin() + begin + new_lengths[i], new_term_freqs.begin() + new_offsets[i]);
+        });
+
+    new_offsets.pop_back();
+    offsets_ = ChunkedArray<uint64_t>(new_offsets);
+    lengths_ = ChunkedArray<uint32_t>(new_lengths);
+    terms_ = ChunkedArray<int32_t>(new_terms);
+    term_freqs_ = ChunkedArray<double>(new_term_freqs);
+}
+
+bool ForwardIndex::Contains(int ordinal, int term) const
+{
+    const auto begin = terms_.begin() + offsets_[ordinal];
+    const auto end = begin + lengths_[ordinal];
+    return binary_search(begin, end, term);
+}
+
+size_t ForwardIndex::GetDocumentCount() const
+{
+    return offsets_.size();
+}
+
+size_t ForwardIndex::GetTermCount(int ordinal) const
+{
+    return lengths_[ordinal];
+}
+
+bool ForwardIndex::HaveSameTerms(int lhs_ordinal, int rhs_ordinal) const
+{
+    const auto lhs_begin = terms_.begin() + offsets_[lhs_ordinal];
+    const auto rhs_begin = terms_.begin() + offsets_[rhs_ordinal];
+    return equal(lhs_begin, lhs_begin + lengths_[lhs_ordinal], rhs_begin, rhs_begin + lengths_[rhs_ordinal]);
+}
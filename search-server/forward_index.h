@@ -0,0 +1,76 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <utility>
+#include <execution>
+#include <cstdint>
+#include "snapshot.h"
+
+//Прямой индекс: для каждого документа - отсортированные по возрастанию id слова и их частоты (TF).
+//Слова всех документов лежат подряд в двух параллельных массивах (без выравнивания пар),
+//документ с порядковым номером o занимает [offsets_[o], offsets_[o] + lengths_[o]). Массивы - ChunkedArray:
+//добавление документа в копию индекса копирует только последние куски
+class ForwardIndex
+{
+public:
+    ForwardIndex() = default;
+
+    //Индекс, читающий слова документов прямо из снимка. Слова каждого документа проверяются: id меньше term_count
+    //и строго растут, TF из (0, 1]. Иначе бросает invalid_argument
+    ForwardIndex(const SnapshotReader& reader, size_t term_count);
+
+    //Пишет в снимок документы с new_ordinals[ordinal] != -1 по порядку новых номеров
+    void Save(SnapshotWriter& writer, const std::vector<int>& new_ordinals) const;
+
+    //Добавляет документ со следующим порядковым номером, term_freqs - пары (id слова, TF) в любом порядке
+    void Add(std::vector<std::pair<int, double>> term_freqs);
+
+    //Забывает слова документа, место освобождается при сжатии
+    void Remove(int ordinal);
+
+    //Оставляет документы с new_ordinals[ordinal] != -1 (перенумерация должна сохранять порядок)
+    void Compact(std::execution::sequenced_policy policy, const std::vector<int>& new_ordinals);
+    void Compact(std::execution::parallel_policy policy, const std::vector<int>& new_ordinals);
+
+    bool Contains(int ordinal, int term) const;
+
+    //Число документов, включая удалённые, но ещё не вычищенные сжатием
+    size_t GetDocumentCount() const;
+
+    //Число различных слов документа
+    size_t GetTermCount(int ordinal) const;
+
+    //Совпадают ли наборы слов двух документов
+    bool HaveSameTerms(int lhs_ordinal, int rhs_ordinal) const;
+
+    //Обходит слова документа по возрастанию id
+    template <typename Function>
+    void ForEachTerm(int ordinal, Function function) const
+    {
+        //Куски обоих массивов начинаются с одних и тех же позиций
+        size_t position = offsets_[ordinal];
+        terms_.ForEachRange(position, position + lengths_[ordinal],
+            [&](const int32_t* terms, size_t count)
+            {
+                const double* term_freqs = &term_freqs_[position];
+                for (size_t i = 0; i < count; ++i)
+                {
+                    function(terms[i], term_freqs[i]);
+                }
+                position += count;
+            });
+    }
+
+private:
+    ChunkedArray<uint64_t> offsets_;
+    ChunkedArray<uint32_t> lengths_;
+    ChunkedArray<int32_t> terms_;
+    ChunkedArray<double> term_freqs_;
+
+    //Новые offsets_ и lengths_ документов с new_ordinals[ordinal] != -1, offsets - на одно длиннее
+    void ComputeCompactLayout(const std::vector<int>& new_ordinals, std::vector<int>& kept,
+        std::vector<uint64_t>& offsets, std::vector<uint32_t>& lengths) const;
+
+    template <typename ExecutionPolicy>
+    void CompactImpl(ExecutionPolicy policy, const std::vector<int>& new_ordinals);
+};
@@ -0,0 +1,174 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+//Гистограмма задержек в наносекундах в духе HDR Histogram: значения меньше 2^SUB_BUCKET_BITS хранятся точно,
+//каждая следующая степень двойки делится на 2^SUB_BUCKET_BITS корзин, так что относительная погрешность
+//не больше 1/2^SUB_BUCKET_BITS (~3%) во всём диапазоне. Значения от 2^MAX_EXPONENT нс (~18 минут) попадают в последнюю корзину.
+//Счётчики атомарные: писать в гистограмму можно из многих потоков, читать - во время записи
+class LatencyHistogram
+{
+public:
+    static const int SUB_BUCKET_BITS = 5;
+    static const int MAX_EXPONENT = 40;
+    static const size_t BUCKET_COUNT = size_t(MAX_EXPONENT - SUB_BUCKET_BITS + 1) << SUB_BUCKET_BITS;
+
+    LatencyHistogram() = default;
+
+    LatencyHistogram(const LatencyHistogram& other)
+    {
+        Merge(other);
+    }
+
+    LatencyHistogram& operator=(const LatencyHistogram& other)
+    {
+        if (this != &other)
+        {
+            Reset();
+            Merge(other);
+        }
+        return *this;
+    }
+
+    void Add(uint64_t value, uint64_t count = 1)
+    {
+        counts_[GetBucket(value)].fetch_add(count, std::memory_order_relaxed);
+    }
+
+    //То же, но без атомарного сложения: годится, только если в гистограмму пишет один поток
+    void AddFromSingleWriter(uint64_t value)
+    {
+        std::atomic<uint64_t>& count = counts_[GetBucket(value)];
+        count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    void Merge(const LatencyHistogram& other)
+    {
+        for (size_t bucket = 0; bucket < BUCKET_COUNT; ++bucket)
+        {
+            const uint64_t count = other.counts_[bucket].load(std::memory_order_relaxed);
+            if (count != 0)
+            {
+                counts_[bucket].fetch_add(count, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void Reset()
+    {
+        for (std::atomic<uint64_t>& count : counts_)
+        {
+            count.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    uint64_t GetCount() const
+    {
+        uint64_t total = 0;
+        for (const std::atomic<uint64_t>& count : counts_)
+        {
+            total += count.load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+    //Значение, не больше которого доля quantile всех значений: верхняя граница корзины, в которую попал
+    //этот процентиль. 0 для пустой гистограммы
+    uint64_t GetPercentile(double quantile) const
+    {
+        const uint64_t total = GetCount();
+        if (total == 0)
+        {
+            return 0;
+        }
+        uint64_t rank = static_cast<uint64_t>(quantile * total + 0.5);
+        rank = rank == 0 ? 1 : rank > total ? total : rank;
+        uint64_t seen = 0;
+        for (size_t bucket = 0; bucket < BUCKET_COUNT; ++bucket)
+        {
+            seen += counts_[bucket].load(std::memory_order_relaxed);
+            if (seen >= rank)
+            {
+                return GetBucketUpperBound(bucket);
+            }
+        }
+        return GetBucketUpperBound(BUCKET_COUNT - 1);
+    }
+
+    uint64_t GetMax() const
+    {
+        for (size_t bucket = BUCKET_COUNT; bucket-- > 0;)
+        {
+            if (counts_[bucket].load(std::memory_order_relaxed) != 0)
+            {
+                return GetBucketUpperBound(bucket);
+            }
+        }
+        return 0;
+    }
+
+    //Обходит непустые корзины по возрастанию: function(нижняя граница, верхняя граница, число значений)
+    template <typename Function>
+    void ForEachBucket(Function function) const
+    {
+        for (size_t bucket = 0; bucket < BUCKET_COUNT; ++bucket)
+        {
+            const uint64_t count = counts_[bucket].load(std::memory_order_relaxed);
+            if (count != 0)
+            {
+                function(GetBucketLowerBound(bucket), GetBucketUpperBound(bucket), count);
+            }
+        }
+    }
+
+private:
+    std::array<std::atomic<uint64_t>, BUCKET_COUNT> counts_{};
+
+    static int FloorLog2(uint64_t value)
+    {
+        int result = 0;
+        for (int shift = 32; shift > 0; shift /= 2)
+        {
+            if (value >> shift)
+            {
+                value >>= shift;
+                result += shift;
+            }
+        }
+        return result;
+    }
+
+    static size_t GetBucket(uint64_t value)
+    {
+        if (value < (uint64_t(1) << SUB_BUCKET_BITS))
+        {
+            return static_cast<size_t>(value);
+        }
+        if (value >= (uint64_t(1) << MAX_EXPONENT))
+        {
+            return BUCKET_COUNT - 1;
+        }
+        const int exponent = FloorLog2(value);
+        const int shift = exponent - SUB_BUCKET_BITS;
+        return (size_t(shift + 1) << SUB_BUCKET_BITS) + static_cast<size_t>((value >> shift) - (uint64_t(1) << SUB_BUCKET_BITS));
+    }
+
+    static uint64_t GetBucketLowerBound(size_t bucket)
+    {
+        const size_t block = bucket >> SUB_BUCKET_BITS;
+        if (block == 0)
+        {
+            return bucket;
+        }
+        const uint64_t sub_bucket = (bucket & ((size_t(1) << SUB_BUCKET_BITS) - 1)) + (uint64_t(1) << SUB_BUCKET_BITS);
+        return sub_bucket << (block - 1);
+    }
+
+    static uint64_t GetBucketUpperBound(size_t bucket)
+    {
+        const size_t block = bucket >> SUB_BUCKET_BITS;
+        return GetBucketLowerBound(bucket) + (block == 0 ? 0 : (uint64_t(1) << (block - 1)) - 1);
+    }
+};
@@ -72,9 +72,16 @@
 
 #include "search_server.h"
 #include "process_queries.h"
+#include "snapshot.h"
 
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
 #include <execution>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <numeric>
 #include <random>
 #include <string>
 #include <vector>
@@ -141,6 +148,126 @@ void Test(string_view mark, SearchServer search_server, const string& query, Exe
 
 #define TEST(policy) Test(#policy, search_server, query, execution::policy)
 
+// Сверяет выдачу с отсечением по блокам (BlockMaxScorer) с полным подсчётом. Последовательный поиск включает отсечение,
+// когда у плюс-слов запроса набирается 32K вхождений, поэтому запросы берутся с числом вхождений на пороге и вокруг него
+// (параллельный - от 32K на каждую часть, на одном ядре порог тот же). Полный подсчёт даёт тот же запрос с top_k,
+// для которого вхождений заведомо мало
+template <typename ExecutionPolicy>
+void TestBlockMaxScoring(string_view mark, const SearchServer& search_server, const vector<pair<string, int>>& queries, ExecutionPolicy&& policy) {
+    const size_t exhaustive_top_k = 1'000;
+    int mismatch_count = 0;
+    for (const auto& [query, posting_count] : queries) {
+        const auto pruned = search_server.FindTopDocuments(policy, query, DocumentStatus::ACTUAL, MAX_RESULT_DOCUMENT_COUNT);
+        auto exhaustive = search_server.FindTopDocuments(policy, query, DocumentStatus::ACTUAL, exhaustive_top_k);
+        exhaustive.resize(min(exhaustive.size(), pruned.size()));
+        const bool same = pruned.size() == static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT)
+            && equal(pruned.begin(), pruned.end(), exhaustive.begin(), [](const Document& lhs, const Document& rhs) {
+                return lhs.id == rhs.id && lhs.relevance == rhs.relevance && lhs.rating == rhs.rating;
+            });
+        if (!same) {
+            ++mismatch_count;
+            cout << mark << ": mismatch for " << posting_count << " postings, query \"" << query << "\"" << endl;
+        }
+    }
+    cout << mark << ": " << queries.size() - mismatch_count << " of " << queries.size() << " queries match exhaustive scoring" << endl;
+}
+
+void TestBlockMaxScoring() {
+    mt19937 generator;
+
+    const int document_count = 40'000;
+    const int threshold = 1 << 15;
+    const auto dictionary = GenerateDictionary(generator, 500, 6);
+    vector<string> texts(document_count);
+    for (string& text : texts) {
+        text = GenerateQuery(generator, dictionary, uniform_int_distribution(1, 30)(generator));
+    }
+
+    // Слово w0 встречается в threshold / 2 документах, слово w<i> - в threshold / 2 + deltas[i - 1],
+    // так что у запроса "w0 w<i>" ровно threshold + deltas[i - 1] вхождений. Повторы дают разные TF
+    const vector<int> deltas = { -1'000, -2, -1, 0, 1, 2, 1'000 };
+    vector<int> ids(document_count);
+    iota(ids.begin(), ids.end(), 0);
+    for (size_t word = 0; word <= deltas.size(); ++word) {
+        const int count = threshold / 2 + (word == 0 ? 0 : deltas[word - 1]);
+        shuffle(ids.begin(), ids.end(), generator);
+        for (int i = 0; i < count; ++i) {
+            const int repeat_count = uniform_int_distribution(1, 3)(generator);
+            for (int repeat = 0; repeat < repeat_count; ++repeat) {
+                texts[ids[i]] += " w" + to_string(word);
+            }
+        }
+    }
+
+    SearchServer search_server(dictionary[0]);
+    for (int id = 0; id < document_count; ++id) {
+        search_server.AddDocument(id, texts[id], DocumentStatus::ACTUAL, { id % 11 - 5 });
+    }
+
+    vector<pair<string, int>> queries;
+    for (size_t word = 1; word <= deltas.size(); ++word) {
+        const int posting_count = threshold + deltas[word - 1];
+        const string query = "w0 w" + to_string(word);
+        queries.push_back({ query, posting_count });
+        // Минус-слова не меняют числа вхождений, по которому выбирается отсечение
+        queries.push_back({ query + " " + GenerateQuery(generator, dictionary, 3, 1.0), posting_count });
+    }
+
+    TestBlockMaxScoring("block max seq", search_server, queries, execution::seq);
+    TestBlockMaxScoring("block max par", search_server, queries, execution::par);
+}
+
+// Портит по одному значению в разделах сохранённого снимка и проверяет, что Open отвергает каждый такой файл,
+// а не отдаёт индекс, который потом читает за границами массивов
+void TestSnapshotCorruption() {
+    const string path = "snapshot_corruption_test.snap";
+    {
+        SearchServer search_server("and in"s);
+        search_server.AddDocument(0, "white cat and fashionable collar"s, DocumentStatus::ACTUAL, { 8, -3 });
+        search_server.AddDocument(1, "fluffy cat fluffy tail"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+        search_server.AddDocument(2, "groomed dog expressive eyes"s, DocumentStatus::BANNED, { 5, -12, 2, 1 });
+        search_server.Save(path);
+    }
+    string snapshot;
+    {
+        ifstream in(path, ios::binary);
+        snapshot.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+    }
+    SnapshotHeader header;
+    memcpy(&header, snapshot.data(), sizeof(header));
+    const auto get_offset = [&header](SnapshotSection section) {
+        return header.sections[static_cast<size_t>(section)].offset;
+    };
+    int32_t first_term = 0;
+    memcpy(&first_term, snapshot.data() + get_offset(SnapshotSection::FORWARD_TERMS), sizeof(first_term));
+
+    int case_count = 0;
+    int rejected_count = 0;
+    const auto check = [&](string_view mark, SnapshotSection section, size_t byte_offset, auto value) {
+        string corrupted = snapshot;
+        memcpy(corrupted.data() + get_offset(section) + byte_offset, &value, sizeof(value));
+        {
+            ofstream out(path, ios::binary | ios::trunc);
+            out << corrupted;
+        }
+        ++case_count;
+        try {
+            SearchServer::Open(path);
+            cout << "snapshot corruption: accepted " << mark << endl;
+        } catch (const invalid_argument&) {
+            ++rejected_count;
+        }
+    };
+    check("forward term id past the dictionary"sv, SnapshotSection::FORWARD_TERMS, 0, int32_t{ 1'000'000 });
+    check("negative forward term id"sv, SnapshotSection::FORWARD_TERMS, 0, int32_t{ -1 });
+    check("repeated forward term id"sv, SnapshotSection::FORWARD_TERMS, sizeof(int32_t), first_term);
+    check("negative term frequency"sv, SnapshotSection::FORWARD_TERM_FREQS, 0, -0.5);
+    check("negative document id"sv, SnapshotSection::DOCUMENTS, 0, int32_t{ -1 });
+    check("posting block past the documents"sv, SnapshotSection::POSTING_BLOCKS, 0, int32_t{ 1'000'000 });
+    remove(path.c_str());
+    cout << "snapshot corruption: " << rejected_count << " of " << case_count << " corrupted snapshots rejected" << endl;
+}
+
 int main() {
     mt19937 generator;
 
@@ -156,4 +283,7 @@ int main() {
 
     TEST(seq);
     TEST(par);
+
+    TestBlockMaxScoring();
+    TestSnapshotCorruption();
  }
\ No newline at end of file
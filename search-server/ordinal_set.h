@@ -0,0 +1,71 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+//Множество порядковых номеров документов из диапазона [first_ordinal, last_ordinal) в виде битовой карты.
+//Номера добавляются словами по 64 подряд идущих номера с любого начала, поэтому плотные блоки списков
+//вхождений, хранящиеся битовыми картами, переносятся в множество целыми словами, без распаковки
+class OrdinalSet
+{
+public:
+    //Очищает множество и задаёт диапазон номеров. Память переиспользуется
+    void Reset(int first_ordinal, int last_ordinal)
+    {
+        first_ordinal_ = first_ordinal;
+        last_ordinal_ = last_ordinal;
+        words_.assign((static_cast<size_t>(last_ordinal - first_ordinal) + 63) / 64, 0);
+    }
+
+    //Добавляет номера first_ordinal + i для единичных битов i слова bits. Номера вне диапазона отбрасываются
+    void Insert(int first_ordinal, uint64_t bits)
+    {
+        if (first_ordinal >= last_ordinal_)
+        {
+            return;
+        }
+        if (last_ordinal_ - first_ordinal < 64)
+        {
+            bits &= (uint64_t(1) << (last_ordinal_ - first_ordinal)) - 1;
+        }
+        if (first_ordinal < first_ordinal_)
+        {
+            if (first_ordinal_ - first_ordinal >= 64)
+            {
+                return;
+            }
+            bits >>= first_ordinal_ - first_ordinal;
+            first_ordinal = first_ordinal_;
+        }
+        const size_t offset = static_cast<size_t>(first_ordinal - first_ordinal_);
+        const size_t word = offset / 64;
+        const size_t shift = offset % 64;
+        words_[word] |= bits << shift;
+        if (shift != 0 && (bits >> (64 - shift)) != 0)
+        {
+            words_[word + 1] |= bits >> (64 - shift);
+        }
+    }
+
+    int GetFirstOrdinal() const
+    {
+        return first_ordinal_;
+    }
+
+    int GetLastOrdinal() const
+    {
+        return last_ordinal_;
+    }
+
+    //Номер должен лежать в диапазоне множества
+    bool Contains(int ordinal) const
+    {
+        const size_t offset = static_cast<size_t>(ordinal - first_ordinal_);
+        return (words_[offset / 64] >> (offset % 64)) & 1;
+    }
+
+private:
+    int first_ordinal_ = 0;
+    int last_ordinal_ = 0;
+    std::vector<uint64_t> words_;
+};
@@ -1,5 +1,7 @@
 #pragma once
 #include <vector>
+#include <iterator>
+#include <ostream>
 
 template <typename Iterator>
 class IteratorRange
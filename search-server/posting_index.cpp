@@ -0,0 +1,682 @@
+#include "posting_index.h"
+#include <algorithm>
+#include <numeric>
+#include <cstring>
+#include <thread>
+#include <type_traits>
+
+using namespace std;
+
+namespace
+{
+    //Хвосты сливаются, когда их суммарный размер превышает половину слитых списков, но не реже этого порога
+    const size_t MIN_TAIL_SIZE_TO_MERGE = 4096;
+
+    //Допустимая ширина разностей номеров или ненулевых кодов TF в блоке
+    bool IsValidByteWidth(size_t width)
+    {
+        return width == 1 || width == 2 || width == 4;
+    }
+
+    //Участков на поток при параллельном кодировании, чтобы потоки не простаивали из-за неравных участков
+    const size_t ENCODE_PARTS_PER_THREAD = 4;
+
+    //Наименьшая из ширин 0, 1, 2 и 4 байта, в которую помещается value
+    size_t GetByteWidth(uint32_t value)
+    {
+        return value == 0 ? 0 : value <= UINT8_MAX ? 1 : value <= UINT16_MAX ? 2 : 4;
+    }
+
+    template <typename Word, typename Value>
+    void AppendWords(vector<uint8_t>& data, size_t count, Value value)
+    {
+        const size_t begin = data.size();
+        data.resize(begin + count * sizeof(Word));
+        for (size_t i = 0; i < count; ++i)
+        {
+            const Word word = static_cast<Word>(value(i));
+            memcpy(data.data() + begin + i * sizeof(Word), &word, sizeof(Word));
+        }
+    }
+
+    //Дописывает значения шириной size байт, см. PostingIndex::Unpack
+    template <typename Value>
+    void AppendPacked(vector<uint8_t>& data, size_t count, size_t size, Value value)
+    {
+        switch (size)
+        {
+        case 0:
+            break;
+        case 1:
+            AppendWords<uint8_t>(data, count, value);
+            break;
+        case 2:
+            AppendWords<uint16_t>(data, count, value);
+            break;
+        default:
+            AppendWords<uint32_t>(data, count, value);
+            break;
+        }
+    }
+
+    uint64_t GetBits(double value)
+    {
+        uint64_t bits = 0;
+        memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+}
+
+PostingIndex::PostingIndex(const SnapshotReader& reader, size_t document_count)
+    : first_blocks_(reader.GetChunkedSection<uint64_t>(SnapshotSection::POSTING_FIRST_BLOCKS))
+    , lengths_(reader.GetChunkedSection<uint64_t>(SnapshotSection::POSTING_LENGTHS))
+    , max_term_freqs_(reader.GetChunkedSection<double>(SnapshotSection::POSTING_MAX_TERM_FREQS))
+    , blocks_(reader.GetSection<PostingBlock>(SnapshotSection::POSTING_BLOCKS))
+    , data_(reader.GetSection<uint8_t>(SnapshotSection::POSTING_DATA))
+    , term_freqs_(reader.GetSection<double>(SnapshotSection::TERM_FREQS))
+    , tails_(first_blocks_.size())
+    , tail_max_term_freqs_(first_blocks_.size(), 0.0)
+{
+    if (lengths_.size() != first_blocks_.size() || max_term_freqs_.size() != first_blocks_.size())
+    {
+        throw std::invalid_argument("Invalid snapshot: posting lists don't match terms");
+    }
+    if (data_.size() < DATA_PADDING)
+    {
+        throw std::invalid_argument("Invalid snapshot: truncated posting data");
+    }
+    for (size_t term = 0; term < first_blocks_.size(); ++term)
+    {
+        const uint64_t block_count = (lengths_[term] + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        if (first_blocks_[term] > blocks_.size() || block_count > blocks_.size() - first_blocks_[term])
+        {
+            throw std::invalid_argument("Invalid snapshot: posting list out of bounds");
+        }
+        const PostingBlock* blocks = blocks_.data() + first_blocks_[term];
+        int previous_ordinal = -1;
+        uint64_t posting_count = 0;
+        for (uint64_t block = 0; block < block_count; ++block)
+        {
+            ValidateBlock(blocks[block], previous_ordinal, document_count);
+            previous_ordinal = blocks[block].last_ordinal;
+            posting_count += blocks[block].posting_count;
+        }
+        if (posting_count != lengths_[term])
+        {
+            throw std::invalid_argument("Invalid snapshot: posting list length doesn't match its blocks");
+        }
+        total_posting_count_ += lengths_[term];
+    }
+    for (size_t code = 0; code < term_freqs_.size(); ++code)
+    {
+        term_freq_codes_.emplace(GetBits(term_freqs_[code]), static_cast<uint32_t>(code));
+    }
+}
+
+void PostingIndex::Save(SnapshotWriter& writer, const vector<int>& new_ordinals) const
+{
+    const EncodedLists lists = EncodeLists(execution::seq, first_blocks_.size(), term_freqs_.data(),
+        [&](size_t term, vector<EncodedPosting>& postings)
+        {
+            //Хвост может перемежаться со слитыми вхождениями по номерам
+            DecodeList(term, postings);
+            const size_t middle = postings.size();
+            postings.insert(postings.end(), tails_[term].begin(), tails_[term].end());
+            inplace_merge(postings.begin(), postings.begin() + middle, postings.end(),
+                [](const EncodedPosting& lhs, const EncodedPosting& rhs)
+                {
+                    return lhs.ordinal < rhs.ordinal;
+                });
+            size_t kept = 0;
+            for (const EncodedPosting& posting : postings)
+            {
+                if (new_ordinals[posting.ordinal] != -1)
+                {
+                    postings[kept++] = { new_ordinals[posting.ordinal], posting.code };
+                }
+            }
+            postings.resize(kept);
+        });
+    writer.WriteSection(SnapshotSection::POSTING_FIRST_BLOCKS, lists.first_blocks.data(), lists.first_blocks.size());
+    writer.WriteSection(SnapshotSection::POSTING_LENGTHS, lists.lengths.data(), lists.lengths.size());
+    writer.WriteSection(SnapshotSection::POSTING_MAX_TERM_FREQS, lists.max_term_freqs.data(), lists.max_term_freqs.size());
+    writer.WriteSection(SnapshotSection::POSTING_BLOCKS, lists.blocks.data(), lists.blocks.size());
+    writer.WriteSection(SnapshotSection::POSTING_DATA, lists.data.data(), lists.data.size());
+    writer.WriteSection(SnapshotSection::TERM_FREQS, term_freqs_.data(), term_freqs_.size());
+}
+
+size_t PostingIndex::AddTerm()
+{
+    first_blocks_.push_back(blocks_.size());
+    lengths_.push_back(0);
+    max_term_freqs_.push_back(0.0);
+    tails_.push_back({});
+    tail_max_term_freqs_.push_back(0.0);
+    return first_blocks_.size() - 1;
+}
+
+void PostingIndex::Add(size_t term, int ordinal, double term_freq)
+{
+    const EncodedPosting posting{ ordinal, GetTermFreqCode(term_freq) };
+    vector<EncodedPosting>& tail = tails_.GetMutable(term);
+    if (tail.empty() || tail.back().ordinal < ordinal)
+    {
+        tail.push_back(posting);
+    }
+    else
+    {
+        tail.insert(lower_bound(tail.begin(), tail.end(), ordinal,
+            [](const EncodedPosting& posting, int ordinal)
+            {
+                return posting.ordinal < ordinal;
+            }),
+            posting);
+    }
+    double& tail_max_term_freq = tail_max_term_freqs_.GetMutable(term);
+    tail_max_term_freq = max(tail_max_term_freq, term_freq);
+
+    ++tail_size_;
+    ++total_posting_count_;
+    MergeIfTailsLarge();
+}
+
+void PostingIndex::Compact(execution::sequenced_policy policy, const vector<int>& new_ordinals)
+{
+    CompactImpl(policy, new_ordinals);
+}
+
+void PostingIndex::Compact(execution::parallel_policy policy, const vector<int>& new_ordinals)
+{
+    CompactImpl(policy, new_ordinals);
+}
+
+template <typename ExecutionPolicy>
+void PostingIndex::CompactImpl(ExecutionPolicy policy, const vector<int>& new_ordinals)
+{
+    EncodedLists lists = EncodeLists(policy, first_blocks_.size(), term_freqs_.data(),
+        [&](size_t term, vector<EncodedPosting>& postings)
+        {
+            DecodeList(term, postings);
+            const size_t middle = postings.size();
+            postings.insert(postings.end(), tails_[term].begin(), tails_[term].end());
+            //Хвост может перемежаться со слитыми вхождениями по номерам
+            inplace_merge(postings.begin(), postings.begin() + middle, postings.end(),
+                [](const EncodedPosting& lhs, const EncodedPosting& rhs)
+                {
+                    return lhs.ordinal < rhs.ordinal;
+                });
+            size_t kept = 0;
+            for (const EncodedPosting& posting : postings)
+            {
+                if (new_ordinals[posting.ordinal] != -1)
+                {
+                    postings[kept++] = { new_ordinals[posting.ordinal], posting.code };
+                }
+            }
+            postings.resize(kept);
+        });
+    SetLists(move(lists));
+}
+
+bool PostingIndex::Contains(size_t term, int ordinal) const
+{
+    const PostingBlock* begin = blocks_.data() + first_blocks_[term];
+    const PostingBlock* end = begin + (lengths_[term] + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    const PostingBlock* block = lower_bound(begin, end, ordinal,
+        [](const PostingBlock& block, int ordinal)
+        {
+            return block.last_ordinal < ordinal;
+        });
+    if (block != end)
+    {
+        const int previous_ordinal = block == begin ? -1 : (block - 1)->last_ordinal;
+        if (block->encoding == BITMAP)
+        {
+            const size_t bit = static_cast<size_t>(ordinal - previous_ordinal - 1);
+            if ((data_[block->data_offset + bit / 8] >> (bit % 8)) & 1)
+            {
+                return true;
+            }
+        }
+        else
+        {
+            int ordinals[BLOCK_SIZE];
+            uint32_t codes[BLOCK_SIZE];
+            DecodeBlock(*block, previous_ordinal, ordinals, codes);
+            if (binary_search(ordinals, ordinals + block->posting_count, ordinal))
+            {
+                return true;
+            }
+        }
+    }
+
+    const vector<EncodedPosting>& tail = tails_[term];
+    auto tail_it = lower_bound(tail.begin(), tail.end(), ordinal,
+        [](const EncodedPosting& posting, int ordinal)
+        {
+            return posting.ordinal < ordinal;
+        });
+    return tail_it != tail.end() && tail_it->ordinal == ordinal;
+}
+
+size_t PostingIndex::GetPostingCount(size_t term) const
+{
+    return lengths_[term] + tails_[term].size();
+}
+
+size_t PostingIndex::GetTermCount() const
+{
+    return first_blocks_.size();
+}
+
+size_t PostingIndex::GetTotalPostingCount() const
+{
+    return total_posting_count_;
+}
+
+size_t PostingIndex::GetEncodedSize() const
+{
+    return first_blocks_.size() * sizeof(uint64_t) + lengths_.size() * sizeof(uint64_t) + max_term_freqs_.size() * sizeof(double)
+        + blocks_.size() * sizeof(PostingBlock) + data_.size() + term_freqs_.size() * sizeof(double);
+}
+
+void PostingIndex::AddBatch(const vector<pair<size_t, Posting>>& postings)
+{
+    //Группировка вхождений по терминам подсчётом, внутри термина порядок пачки сохраняется
+    const size_t term_count = first_blocks_.size();
+    vector<size_t> batch_offsets(term_count + 1, 0);
+    for (const auto& [term, posting] : postings)
+    {
+        ++batch_offsets[term + 1];
+    }
+    for (size_t term = 0; term < term_count; ++term)
+    {
+        batch_offsets[term + 1] += batch_offsets[term];
+    }
+    vector<EncodedPosting> batch(postings.size());
+    vector<size_t> positions(batch_offsets.begin(), batch_offsets.end() - 1);
+    //Вхождения одного документа идут подряд и чаще всего имеют одну TF (слово встретилось один раз)
+    double last_term_freq = -1.0;
+    uint32_t last_code = 0;
+    for (const auto& [term, posting] : postings)
+    {
+        if (posting.term_freq != last_term_freq)
+        {
+            last_term_freq = posting.term_freq;
+            last_code = GetTermFreqCode(posting.term_freq);
+        }
+        batch[positions[term]++] = { posting.ordinal, last_code };
+    }
+    const auto less_by_ordinal = [](const EncodedPosting& lhs, const EncodedPosting& rhs)
+    {
+        return lhs.ordinal < rhs.ordinal;
+    };
+    for (size_t term = 0; term < term_count; ++term)
+    {
+        if (batch_offsets[term] == batch_offsets[term + 1])
+        {
+            continue;
+        }
+        const auto begin = batch.begin() + batch_offsets[term];
+        const auto end = batch.begin() + batch_offsets[term + 1];
+        sort(begin, end, less_by_ordinal);
+        vector<EncodedPosting>& tail = tails_.GetMutable(term);
+        const size_t middle = tail.size();
+        tail.insert(tail.end(), begin, end);
+        //Обычно пачка состоит из новых документов и просто дописывается в конец хвоста
+        if (middle != 0 && tail[middle].ordinal < tail[middle - 1].ordinal)
+        {
+            inplace_merge(tail.begin(), tail.begin() + middle, tail.end(), less_by_ordinal);
+        }
+        double& tail_max_term_freq = tail_max_term_freqs_.GetMutable(term);
+        for (auto it = begin; it != end; ++it)
+        {
+            tail_max_term_freq = max(tail_max_term_freq, term_freqs_[it->code]);
+        }
+    }
+
+    tail_size_ += postings.size();
+    total_posting_count_ += postings.size();
+    MergeIfTailsLarge();
+}
+
+void PostingIndex::MergeIfTailsLarge()
+{
+    if (tail_size_ > max(MIN_TAIL_SIZE_TO_MERGE, (total_posting_count_ - tail_size_) / 2))
+    {
+        Merge();
+    }
+}
+
+void PostingIndex::Merge()
+{
+    const auto collect = [this](size_t term, vector<EncodedPosting>& postings)
+    {
+        DecodeList(term, postings);
+        const vector<EncodedPosting>& tail = tails_[term];
+        const size_t middle = postings.size();
+        postings.insert(postings.end(), tail.begin(), tail.end());
+        //Хвост может перемежаться со слитыми вхождениями по номерам
+        inplace_merge(postings.begin(), postings.begin() + middle, postings.end(),
+            [](const EncodedPosting& lhs, const EncodedPosting& rhs)
+            {
+                return lhs.ordinal < rhs.ordinal;
+            });
+    };
+
+    vector<size_t> terms;
+    size_t replaced_block_count = 0;
+    for (size_t term = 0; term < tails_.size(); ++term)
+    {
+        if (!tails_[term].empty())
+        {
+            terms.push_back(term);
+            replaced_block_count += (lengths_[term] + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        }
+    }
+
+    //Когда мёртвых блоков станет больше живых, все списки перепаковываются подряд
+    if ((dead_block_count_ + replaced_block_count) * 2 > blocks_.size())
+    {
+        SetLists(EncodeLists(execution::seq, first_blocks_.size(), term_freqs_.data(), collect));
+        return;
+    }
+
+    EncodedLists lists = EncodeLists(execution::seq, terms.size(), term_freqs_.data(),
+        [&](size_t i, vector<EncodedPosting>& postings)
+        {
+            collect(terms[i], postings);
+        });
+    //Новые блоки и данные дописываются в конец, смещения данных сдвигаются на прежний размер данных
+    vector<PostingBlock>& blocks = blocks_.GetOwned();
+    vector<uint8_t>& data = data_.GetOwned();
+    const uint64_t block_base = blocks.size();
+    const uint64_t data_base = data.size();
+    for (PostingBlock block : lists.blocks)
+    {
+        block.data_offset += data_base;
+        blocks.push_back(block);
+    }
+    data.insert(data.end(), lists.data.begin(), lists.data.end());
+
+    for (size_t i = 0; i < terms.size(); ++i)
+    {
+        const size_t term = terms[i];
+        first_blocks_.GetMutable(term) = block_base + lists.first_blocks[i];
+        lengths_.GetMutable(term) = lists.lengths[i];
+        max_term_freqs_.GetMutable(term) = lists.max_term_freqs[i];
+        vector<EncodedPosting>().swap(tails_.GetMutable(term));
+        tail_max_term_freqs_.GetMutable(term) = 0.0;
+    }
+    dead_block_count_ += replaced_block_count;
+    tail_size_ = 0;
+}
+
+void PostingIndex::DecodeList(size_t term, vector<EncodedPosting>& out) const
+{
+    out.reserve(out.size() + lengths_[term]);
+    ForEachEncoded(term, 0,
+        [&out](int ordinal, uint32_t code)
+        {
+            out.push_back({ ordinal, code });
+            return true;
+        });
+}
+
+void PostingIndex::ValidateBlock(const PostingBlock& block, int previous_ordinal, size_t document_count) const
+{
+    const size_t count = block.posting_count;
+    if (count == 0 || count > BLOCK_SIZE || (block.encoding != PACKED && block.encoding != BITMAP)
+        || !IsValidByteWidth(block.gap_size) || (block.code_size != 0 && !IsValidByteWidth(block.code_size)))
+    {
+        throw std::invalid_argument("Invalid snapshot: bad posting block");
+    }
+    //Номера блока различны и лежат в (previous_ordinal, last_ordinal]
+    if (block.last_ordinal <= previous_ordinal || static_cast<size_t>(block.last_ordinal) >= document_count
+        || static_cast<size_t>(block.last_ordinal - previous_ordinal) < count)
+    {
+        throw std::invalid_argument("Invalid snapshot: bad posting block ordinals");
+    }
+
+    const size_t ordinals_size = block.encoding == PACKED ? count * block.gap_size : GetBitmapSize(block, previous_ordinal);
+    const size_t data_size = data_.size() - DATA_PADDING;
+    if (block.data_offset > data_size || ordinals_size + count * block.code_size > data_size - block.data_offset)
+    {
+        throw std::invalid_argument("Invalid snapshot: posting block out of bounds");
+    }
+
+    //Разности считаются без переполнения: каждая не меньше 1, а вместе они доходят ровно до last_ordinal
+    bool ordinals_valid = true;
+    if (block.encoding == PACKED)
+    {
+        uint32_t gaps[BLOCK_SIZE];
+        Unpack(data_.data() + block.data_offset, count, block.gap_size, gaps);
+        int64_t ordinal = previous_ordinal;
+        for (size_t i = 0; i < count; ++i)
+        {
+            ordinals_valid = ordinals_valid && gaps[i] != 0;
+            ordinal += gaps[i];
+        }
+        ordinals_valid = ordinals_valid && ordinal == block.last_ordinal;
+    }
+    else
+    {
+        //В карте должно быть ровно count бит, и старший из них - last_ordinal
+        size_t bit_count = 0;
+        int last_ordinal = previous_ordinal;
+        ForEachBitmapWord(block, previous_ordinal,
+            [&](int first_ordinal, uint64_t bits)
+            {
+                for (; bits != 0; bits &= bits - 1)
+                {
+                    ++bit_count;
+                    last_ordinal = first_ordinal + CountTrailingZeros(bits);
+                }
+            });
+        ordinals_valid = bit_count == count && last_ordinal == block.last_ordinal;
+    }
+    if (!ordinals_valid)
+    {
+        throw std::invalid_argument("Invalid snapshot: bad posting block ordinals");
+    }
+
+    uint32_t codes[BLOCK_SIZE];
+    Unpack(data_.data() + block.data_offset + ordinals_size, count, block.code_size, codes);
+    double max_term_freq = 0.0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (codes[i] >= term_freqs_.size())
+        {
+            throw std::invalid_argument("Invalid snapshot: posting term frequency code out of range");
+        }
+        max_term_freq = max(max_term_freq, term_freqs_[codes[i]]);
+    }
+    //По max_term_freq отсекаются блоки при ранжировании, заниженная оценка потеряла бы документы
+    if (max_term_freq != block.max_term_freq)
+    {
+        throw std::invalid_argument("Invalid snapshot: bad posting block term frequency bound");
+    }
+}
+
+uint32_t PostingIndex::GetTermFreqCode(double term_freq)
+{
+    const auto [it, inserted] = term_freq_codes_.emplace(GetBits(term_freq), static_cast<uint32_t>(term_freqs_.size()));
+    if (inserted)
+    {
+        term_freqs_.GetOwned().push_back(term_freq);
+    }
+    return it->second;
+}
+
+void PostingIndex::EncodeBlock(const EncodedPosting* postings, size_t count, int previous_ordinal, const double* term_freqs, EncodedLists& lists)
+{
+    PostingBlock block;
+    block.last_ordinal = postings[count - 1].ordinal;
+    block.posting_count = static_cast<uint8_t>(count);
+    block.data_offset = lists.data.size();
+
+    uint32_t max_gap = 0;
+    uint32_t max_code = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        max_gap = max(max_gap, static_cast<uint32_t>(postings[i].ordinal - (i == 0 ? previous_ordinal : postings[i - 1].ordinal)));
+        max_code = max(max_code, postings[i].code);
+        block.max_term_freq = max(block.max_term_freq, term_freqs[postings[i].code]);
+    }
+    block.gap_size = static_cast<uint8_t>(GetByteWidth(max_gap));
+    block.code_size = static_cast<uint8_t>(GetByteWidth(max_code));
+
+    //Карта выгоднее, когда на документ диапазона номеров приходится меньше бит, чем на разность, то есть документы идут плотно
+    vector<uint8_t>& data = lists.data;
+    const size_t bitmap_size = GetBitmapSize(block, previous_ordinal);
+    if (bitmap_size < count * block.gap_size)
+    {
+        block.encoding = BITMAP;
+        data.resize(data.size() + bitmap_size, 0);
+        uint8_t* bitmap = data.data() + block.data_offset;
+        for (size_t i = 0; i < count; ++i)
+        {
+            const size_t bit = static_cast<size_t>(postings[i].ordinal - previous_ordinal - 1);
+            bitmap[bit / 8] |= static_cast<uint8_t>(1u << (bit % 8));
+        }
+    }
+    else
+    {
+        block.encoding = PACKED;
+        AppendPacked(data, count, block.gap_size,
+            [&](size_t i)
+            {
+                return static_cast<uint32_t>(postings[i].ordinal - (i == 0 ? previous_ordinal : postings[i - 1].ordinal));
+            });
+    }
+    AppendPacked(data, count, block.code_size,
+        [&](size_t i)
+        {
+            return postings[i].code;
+        });
+    lists.blocks.push_back(block);
+}
+
+template <typename ExecutionPolicy, typename Collect>
+PostingIndex::EncodedLists PostingIndex::EncodeLists(ExecutionPolicy policy, size_t term_count, const double* term_freqs, Collect collect)
+{
+    size_t part_count = 1;
+    if constexpr (is_same_v<ExecutionPolicy, execution::parallel_policy>)
+    {
+        part_count = min(max<size_t>(term_count, 1), max(1u, thread::hardware_concurrency()) * ENCODE_PARTS_PER_THREAD);
+    }
+    vector<EncodedLists> parts(part_count);
+    vector<size_t> part_ids(part_count);
+    iota(part_ids.begin(), part_ids.end(), 0);
+    for_each(
+        policy,
+        part_ids.begin(), part_ids.end(),
+        [&](size_t part)
+        {
+            EncodedLists& lists = parts[part];
+            vector<EncodedPosting> postings;
+            for (size_t term = term_count * part / part_count; term < term_count * (part + 1) / part_count; ++term)
+            {
+                postings.clear();
+                collect(term, postings);
+                lists.first_blocks.push_back(lists.blocks.size());
+                lists.lengths.push_back(postings.size());
+                double max_term_freq = 0.0;
+                for (size_t begin = 0; begin < postings.size(); begin += BLOCK_SIZE)
+                {
+                    EncodeBlock(postings.data() + begin, min(BLOCK_SIZE, postings.size() - begin),
+                        begin == 0 ? -1 : postings[begin - 1].ordinal, term_freqs, lists);
+                    max_term_freq = max(max_term_freq, lists.blocks.back().max_term_freq);
+                }
+                lists.max_term_freqs.push_back(max_term_freq);
+            }
+        });
+
+    //Участки склеиваются со сдвигом номеров блоков и смещений данных
+    EncodedLists lists = move(parts[0]);
+    for (size_t part = 1; part < part_count; ++part)
+    {
+        const EncodedLists& part_lists = parts[part];
+        const uint64_t block_base = lists.blocks.size();
+        const uint64_t data_base = lists.data.size();
+        for (uint64_t first_block : part_lists.first_blocks)
+        {
+            lists.first_blocks.push_back(block_base + first_block);
+        }
+        lists.lengths.insert(lists.lengths.end(), part_lists.lengths.begin(), part_lists.lengths.end());
+        lists.max_term_freqs.insert(lists.max_term_freqs.end(), part_lists.max_term_freqs.begin(), part_lists.max_term_freqs.end());
+        for (PostingBlock block : part_lists.blocks)
+        {
+            block.data_offset += data_base;
+            lists.blocks.push_back(block);
+        }
+        lists.data.insert(lists.data.end(), part_lists.data.begin(), part_lists.data.end());
+    }
+    lists.data.resize(lists.data.size() + DATA_PADDING, 0);
+    return lists;
+}
+
+void PostingIndex::SetLists(EncodedLists lists)
+{
+    total_posting_count_ = accumulate(lists.lengths.begin(), lists.lengths.end(), size_t{ 0 });
+    first_blocks_ = ChunkedArray<uint64_t>(lists.first_blocks);
+    lengths_ = ChunkedArray<uint64_t>(lists.lengths);
+    max_term_freqs_ = ChunkedArray<double>(lists.max_term_freqs);
+    blocks_ = move(lists.blocks);
+    data_ = move(lists.data);
+    tails_ = ChunkedArray<vector<EncodedPosting>>(first_blocks_.size());
+    tail_max_term_freqs_.assign(first_blocks_.size(), 0.0);
+    tail_size_ = 0;
+    dead_block_count_ = 0;
+}
+
+void PostingIndex::Cursor::Open(const PostingIndex& index, size_t term, int first_ordinal)
+{
+    index_ = &index;
+    term_freqs_ = index.term_freqs_.data();
+    blocks_begin_ = index.blocks_.data() + index.first_blocks_[term];
+    blocks_end_ = blocks_begin_ + (index.lengths_[term] + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    if (!buffer_)
+    {
+        buffer_ = make_unique<EncodedPosting[]>(BLOCK_SIZE);
+    }
+    tail_ = false;
+    max_term_freq_ = index.max_term_freqs_[term];
+    block_last_ordinal_ = -1;
+    block_max_term_freq_ = 0.0;
+    LoadBlock(FindBlock(blocks_begin_, first_ordinal));
+    Seek(first_ordinal);
+}
+
+void PostingIndex::Cursor::OpenTail(const PostingIndex& index, size_t term, int first_ordinal)
+{
+    const vector<EncodedPosting>& tail = index.tails_[term];
+    index_ = &index;
+    term_freqs_ = index.term_freqs_.data();
+    blocks_begin_ = blocks_end_ = block_ = nullptr;
+    current_ = tail.data();
+    end_ = tail.data() + tail.size();
+    tail_ = true;
+    max_term_freq_ = index.tail_max_term_freqs_[term];
+    block_last_ordinal_ = -1;
+    block_max_term_freq_ = 0.0;
+    Seek(first_ordinal);
+}
+
+void PostingIndex::Cursor::LoadBlock(const PostingBlock* block)
+{
+    block_ = block;
+    current_ = end_ = buffer_.get();
+    if (block == blocks_end_)
+    {
+        return;
+    }
+    int ordinals[BLOCK_SIZE];
+    uint32_t codes[BLOCK_SIZE];
+    index_->DecodeBlock(*block, block == blocks_begin_ ? -1 : (block - 1)->last_ordinal, ordinals, codes);
+    for (size_t i = 0; i < block->posting_count; ++i)
+    {
+        buffer_[i] = { ordinals[i], codes[i] };
+    }
+    end_ = current_ + block->posting_count;
+}
@@ -0,0 +1,549 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <utility>
+#include <execution>
+#include <unordered_map>
+#include <memory>
+#include <limits>
+#include "snapshot.h"
+#include "ordinal_set.h"
+
+//Вхождение термина: порядковый номер документа - частота слова в документе (TF)
+struct Posting
+{
+    int ordinal = 0;
+    double term_freq = 0.0;
+};
+
+//Блок сжатого списка вхождений: до PostingIndex::BLOCK_SIZE вхождений подряд, данные блока лежат в общем
+//массиве байт с data_offset. Блоки термина идут подряд и служат указателями пропуска: по last_ordinal нужный
+//блок находится двоичным поиском, предыдущие блоки не распаковываются. По max_term_freq можно оценить сверху
+//вклад вхождений блока в релевантность, тоже не распаковывая его
+struct PostingBlock
+{
+    int32_t last_ordinal = 0;
+    uint8_t posting_count = 0;
+    uint8_t encoding = 0;                           //PostingIndex::BlockEncoding
+    uint8_t gap_size = 0;                           //Байт на разность номеров: 1, 2 или 4
+    uint8_t code_size = 0;                          //Байт на код TF: 0 (все коды нулевые), 1, 2 или 4
+    uint64_t data_offset = 0;
+    double max_term_freq = 0.0;                     //Наибольшая TF вхождений блока
+};
+
+//Инвертированный индекс со сжатыми списками вхождений. Список термина t - это lengths_[t] вхождений
+//в блоках начиная с first_blocks_[t], по возрастанию порядкового номера документа. В блоке хранятся
+//разности соседних номеров (от последнего номера предыдущего блока) и коды TF, каждые - числами одной
+//на весь блок ширины в 1, 2 или 4 байта: такой блок распаковывается простым копированием, без разбора
+//каждого значения. Если документы блока идут плотно, вместо разностей хранится битовая карта номеров.
+//TF не округляются: код - номер значения в таблице различных TF, таких значений немного (TF - это
+//число вхождений слова, делённое на длину документа), так что код занимает несколько бит.
+//Новые вхождения копятся в несжатых хвостах и сливаются в блоки пачкой, когда хвостов становится много:
+//перекодируются только списки терминов с хвостами, их новые блоки дописываются в конец, а старые
+//остаются мёртвыми до полной перепаковки, которая делается, когда мёртвых блоков становится больше живых.
+class PostingIndex
+{
+public:
+    static constexpr size_t BLOCK_SIZE = 128;
+
+    enum BlockEncoding : uint8_t
+    {
+        PACKED,
+        BITMAP
+    };
+
+    PostingIndex() = default;
+
+    //Индекс, читающий списки вхождений прямо из снимка. Каждый блок проверяется: данные в границах,
+    //номера растут и меньше document_count, коды TF есть в таблице. Иначе бросает invalid_argument
+    PostingIndex(const SnapshotReader& reader, size_t document_count);
+
+    //Пишет в снимок списки вхождений документов с new_ordinals[ordinal] != -1 под новыми номерами, вместе с хвостами
+    void Save(SnapshotWriter& writer, const std::vector<int>& new_ordinals) const;
+
+    class Cursor;
+
+    //Заводит пустой список вхождений для следующего термина и возвращает его номер
+    size_t AddTerm();
+
+    //Добавляет вхождение документа в список термина (документ в списке должен отсутствовать)
+    void Add(size_t term, int ordinal, double term_freq);
+
+    //Добавляет пачку вхождений (номер термина, вхождение) в хвосты, как Add, но с одной группировкой
+    //по терминам на всю пачку. Документы пачки должны отсутствовать в списках своих терминов
+    void AddBatch(const std::vector<std::pair<size_t, Posting>>& postings);
+
+    //Убирает вхождения документов с new_ordinals[ordinal] == -1, остальным номерам присваивает new_ordinals[ordinal]
+    //(перенумерация должна сохранять порядок) и сливает хвосты в блоки. Термины обрабатываются параллельно
+    void Compact(std::execution::sequenced_policy policy, const std::vector<int>& new_ordinals);
+    void Compact(std::execution::parallel_policy policy, const std::vector<int>& new_ordinals);
+
+    bool Contains(size_t term, int ordinal) const;
+
+    //Количество документов, в которых встречается термин
+    size_t GetPostingCount(size_t term) const;
+
+    size_t GetTermCount() const;
+
+    //Общее число вхождений всех терминов
+    size_t GetTotalPostingCount() const;
+
+    //Байт, занятых слитыми списками: данные блоков, указатели пропуска, таблицы терминов и TF. Хвосты не учитываются
+    size_t GetEncodedSize() const;
+
+    template <typename Function>
+    void ForEachPosting(size_t term, Function function) const
+    {
+        const double* term_freqs = term_freqs_.data();
+        ForEachEncoded(term, 0,
+            [&](int ordinal, uint32_t code)
+            {
+                function(Posting{ ordinal, term_freqs[code] });
+                return true;
+            });
+        for (const EncodedPosting& posting : tails_[term])
+        {
+            function(Posting{ posting.ordinal, term_freqs[posting.code] });
+        }
+    }
+
+    //Обходит только вхождения документов с номерами из [first_ordinal, last_ordinal)
+    template <typename Function>
+    void ForEachPostingInRange(size_t term, int first_ordinal, int last_ordinal, Function function) const
+    {
+        const double* term_freqs = term_freqs_.data();
+        ForEachEncoded(term, first_ordinal,
+            [&](int ordinal, uint32_t code)
+            {
+                if (ordinal >= last_ordinal)
+                {
+                    return false;
+                }
+                if (ordinal >= first_ordinal)
+                {
+                    function(Posting{ ordinal, term_freqs[code] });
+                }
+                return true;
+            });
+        const std::vector<EncodedPosting>& tail = tails_[term];
+        auto it = std::lower_bound(tail.begin(), tail.end(), first_ordinal,
+            [](const EncodedPosting& posting, int ordinal)
+            {
+                return posting.ordinal < ordinal;
+            });
+        for (; it != tail.end() && it->ordinal < last_ordinal; ++it)
+        {
+            function(Posting{ it->ordinal, term_freqs[it->code] });
+        }
+    }
+
+    //Добавляет в ordinals номера документов термина из диапазона множества, не распаковывая TF.
+    //Блоки, записанные битовыми картами, добавляются словами по 64 номера
+    void CollectOrdinals(size_t term, OrdinalSet& ordinals) const
+    {
+        const PostingBlock* begin = blocks_.data() + first_blocks_[term];
+        const PostingBlock* end = begin + (lengths_[term] + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        const PostingBlock* block = std::lower_bound(begin, end, ordinals.GetFirstOrdinal(),
+            [](const PostingBlock& block, int ordinal)
+            {
+                return block.last_ordinal < ordinal;
+            });
+        int block_ordinals[BLOCK_SIZE];
+        for (; block != end; ++block)
+        {
+            const int previous_ordinal = block == begin ? -1 : (block - 1)->last_ordinal;
+            if (previous_ordinal + 1 >= ordinals.GetLastOrdinal())
+            {
+                break;
+            }
+            if (block->encoding == BITMAP)
+            {
+                ForEachBitmapWord(*block, previous_ordinal,
+                    [&ordinals](int first_ordinal, uint64_t bits)
+                    {
+                        ordinals.Insert(first_ordinal, bits);
+                    });
+                continue;
+            }
+            DecodeGaps(*block, previous_ordinal, block_ordinals);
+            for (size_t i = 0; i < block->posting_count; ++i)
+            {
+                ordinals.Insert(block_ordinals[i], 1);
+            }
+        }
+        const std::vector<EncodedPosting>& tail = tails_[term];
+        auto it = std::lower_bound(tail.begin(), tail.end(), ordinals.GetFirstOrdinal(),
+            [](const EncodedPosting& posting, int ordinal)
+            {
+                return posting.ordinal < ordinal;
+            });
+        for (; it != tail.end() && it->ordinal < ordinals.GetLastOrdinal(); ++it)
+        {
+            ordinals.Insert(it->ordinal, 1);
+        }
+    }
+
+private:
+    //Вхождение с TF, заменённой кодом из term_freqs_
+    struct EncodedPosting
+    {
+        int ordinal = 0;
+        uint32_t code = 0;
+    };
+
+    //Заново закодированные списки всех терминов
+    struct EncodedLists
+    {
+        std::vector<uint64_t> first_blocks;
+        std::vector<uint64_t> lengths;
+        std::vector<double> max_term_freqs;
+        std::vector<PostingBlock> blocks;
+        std::vector<uint8_t> data;
+    };
+
+    ChunkedArray<uint64_t> first_blocks_;           //Первый блок каждого термина в blocks_
+    ChunkedArray<uint64_t> lengths_;                //Число вхождений термина в блоках
+    ChunkedArray<double> max_term_freqs_;           //Наибольшая TF вхождений термина в блоках
+    SharedArray<PostingBlock> blocks_;              //Указатели пропуска всех терминов подряд
+    SharedArray<uint8_t> data_;                     //Содержимое блоков
+    SharedArray<double> term_freqs_;                //Код - значение TF, только дописывается
+    std::unordered_map<uint64_t, uint32_t> term_freq_codes_;  //Биты значения TF - код
+    ChunkedArray<std::vector<EncodedPosting>> tails_;         //Ещё не слитые вхождения, тоже по возрастанию номера
+    ChunkedArray<double> tail_max_term_freqs_;                //Наибольшая TF хвоста термина
+    size_t tail_size_ = 0;
+    size_t total_posting_count_ = 0;
+    size_t dead_block_count_ = 0;                             //Блоки blocks_, на которые не ссылается ни один список
+
+    //Битовая карта читается по 8 байт с любого смещения, поэтому за данными блоков всегда лежат DATA_PADDING нулей
+    static const size_t DATA_PADDING = 8;
+
+    static uint64_t LoadWord(const uint8_t* bytes)
+    {
+#if defined(_MSC_VER) || (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+        uint64_t word = 0;
+        std::memcpy(&word, bytes, sizeof(word));
+        return word;
+#else
+        return static_cast<uint64_t>(bytes[0]) | static_cast<uint64_t>(bytes[1]) << 8
+            | static_cast<uint64_t>(bytes[2]) << 16 | static_cast<uint64_t>(bytes[3]) << 24
+            | static_cast<uint64_t>(bytes[4]) << 32 | static_cast<uint64_t>(bytes[5]) << 40
+            | static_cast<uint64_t>(bytes[6]) << 48 | static_cast<uint64_t>(bytes[7]) << 56;
+#endif
+    }
+
+    //Значения шириной size байт подряд, в порядке байтов машины
+    static void Unpack(const uint8_t* bytes, size_t count, size_t size, uint32_t* values)
+    {
+        switch (size)
+        {
+        case 0:
+            std::fill(values, values + count, 0u);
+            break;
+        case 1:
+            UnpackWords<uint8_t>(bytes, count, values);
+            break;
+        case 2:
+            UnpackWords<uint16_t>(bytes, count, values);
+            break;
+        default:
+            UnpackWords<uint32_t>(bytes, count, values);
+            break;
+        }
+    }
+
+    template <typename Word>
+    static void UnpackWords(const uint8_t* bytes, size_t count, uint32_t* values)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            Word word;
+            std::memcpy(&word, bytes + i * sizeof(Word), sizeof(Word));
+            values[i] = word;
+        }
+    }
+
+    static int CountTrailingZeros(uint64_t bits)
+    {
+#if defined(__GNUC__)
+        return __builtin_ctzll(bits);
+#else
+        int count = 0;
+        for (; (bits & 1) == 0; bits >>= 1)
+        {
+            ++count;
+        }
+        return count;
+#endif
+    }
+
+    //Распаковывает блок в ordinals и codes (не меньше BLOCK_SIZE элементов)
+    void DecodeBlock(const PostingBlock& block, int previous_ordinal, int* ordinals, uint32_t* codes) const
+    {
+        const uint8_t* bytes = data_.data() + block.data_offset;
+        const size_t count = block.posting_count;
+        if (block.encoding == PACKED)
+        {
+            DecodeGaps(block, previous_ordinal, ordinals);
+            bytes += count * block.gap_size;
+        }
+        else
+        {
+            size_t i = 0;
+            ForEachBitmapWord(block, previous_ordinal,
+                [&](int first_ordinal, uint64_t bits)
+                {
+                    for (; bits != 0; bits &= bits - 1)
+                    {
+                        ordinals[i++] = first_ordinal + CountTrailingZeros(bits);
+                    }
+                });
+            bytes += GetBitmapSize(block, previous_ordinal);
+        }
+        Unpack(bytes, count, block.code_size, codes);
+    }
+
+    //Распаковывает номера блока, записанного разностями
+    void DecodeGaps(const PostingBlock& block, int previous_ordinal, int* ordinals) const
+    {
+        uint32_t gaps[BLOCK_SIZE];
+        Unpack(data_.data() + block.data_offset, block.posting_count, block.gap_size, gaps);
+        int ordinal = previous_ordinal;
+        for (size_t i = 0; i < block.posting_count; ++i)
+        {
+            ordinal += static_cast<int>(gaps[i]);
+            ordinals[i] = ordinal;
+        }
+    }
+
+    static size_t GetBitmapSize(const PostingBlock& block, int previous_ordinal)
+    {
+        return (static_cast<size_t>(block.last_ordinal - previous_ordinal) + 7) / 8;
+    }
+
+    //Обходит карту блока, записанного битовой картой, словами: function(first_ordinal, bits), бит i слова -
+    //документ first_ordinal + i. Бит i карты - документ previous_ordinal + 1 + i
+    template <typename Function>
+    void ForEachBitmapWord(const PostingBlock& block, int previous_ordinal, Function function) const
+    {
+        const uint8_t* bytes = data_.data() + block.data_offset;
+        const size_t bitmap_size = GetBitmapSize(block, previous_ordinal);
+        for (size_t byte = 0; byte < bitmap_size; byte += 8)
+        {
+            uint64_t bits = LoadWord(bytes + byte);
+            if (bitmap_size - byte < 8)
+            {
+                bits &= (uint64_t(1) << (8 * (bitmap_size - byte))) - 1;
+            }
+            function(previous_ordinal + 1 + static_cast<int>(byte * 8), bits);
+        }
+    }
+
+    //Обходит слитые вхождения термина начиная с блока, в котором может быть first_ordinal, пока function возвращает true
+    template <typename Function>
+    void ForEachEncoded(size_t term, int first_ordinal, Function function) const
+    {
+        const PostingBlock* begin = blocks_.data() + first_blocks_[term];
+        const PostingBlock* end = begin + (lengths_[term] + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        const PostingBlock* block = begin;
+        if (first_ordinal > 0)
+        {
+            block = std::lower_bound(begin, end, first_ordinal,
+                [](const PostingBlock& block, int ordinal)
+                {
+                    return block.last_ordinal < ordinal;
+                });
+        }
+        int ordinals[BLOCK_SIZE];
+        uint32_t codes[BLOCK_SIZE];
+        for (; block != end; ++block)
+        {
+            DecodeBlock(*block, block == begin ? -1 : (block - 1)->last_ordinal, ordinals, codes);
+            for (size_t i = 0; i < block->posting_count; ++i)
+            {
+                if (!function(ordinals[i], codes[i]))
+                {
+                    return;
+                }
+            }
+        }
+    }
+
+    //Распаковывает слитые вхождения термина в out
+    void DecodeList(size_t term, std::vector<EncodedPosting>& out) const;
+
+    //Проверяет блок из снимка, previous_ordinal - последний номер предыдущего блока термина или -1
+    void ValidateBlock(const PostingBlock& block, int previous_ordinal, size_t document_count) const;
+
+    //Дописывает в lists блок из count вхождений, previous_ordinal - последний номер предыдущего блока или -1.
+    //term_freqs - таблица значений TF по кодам
+    static void EncodeBlock(const EncodedPosting* postings, size_t count, int previous_ordinal, const double* term_freqs, EncodedLists& lists);
+
+    //Код значения TF, при необходимости новый
+    uint32_t GetTermFreqCode(double term_freq);
+
+    //Кодирует списки term_count терминов. collect(term, out) кладёт в out вхождения термина по возрастанию номера.
+    //Термины делятся на участки, участки кодируются независимо и склеиваются
+    template <typename ExecutionPolicy, typename Collect>
+    static EncodedLists EncodeLists(ExecutionPolicy policy, size_t term_count, const double* term_freqs, Collect collect);
+
+    void SetLists(EncodedLists lists);
+
+    template <typename ExecutionPolicy>
+    void CompactImpl(ExecutionPolicy policy, const std::vector<int>& new_ordinals);
+
+    //Сливает хвосты, если в них накопилась заметная доля всех вхождений
+    void MergeIfTailsLarge();
+
+    //Сливает хвосты со списками своих терминов. Списки без хвостов не перекодируются
+    void Merge();
+};
+
+//Курсор по вхождениям одного термина по возрастанию номера: либо по слитым блокам, либо по хвосту термина.
+//Нужен для обхода документ за документом: Seek перескакивает к номеру по указателям пропуска и распаковывает
+//только блок с этим номером, а SeekBlock находит такой блок вовсе без распаковки, чтобы узнать его наибольшую TF.
+//Хвост курсор делит на блоки на ходу. Курсор можно переносить, но не копировать
+class PostingIndex::Cursor
+{
+public:
+    static const int END = std::numeric_limits<int>::max();
+
+    //Слитые вхождения термина начиная с блока, в котором может быть first_ordinal
+    void Open(const PostingIndex& index, size_t term, int first_ordinal = 0);
+
+    //Хвост термина начиная с первого вхождения с номером не меньше first_ordinal
+    void OpenTail(const PostingIndex& index, size_t term, int first_ordinal = 0);
+
+    //Номер текущего вхождения или END, если вхождения кончились
+    int GetOrdinal() const
+    {
+        return current_ != end_ ? current_->ordinal : END;
+    }
+
+    double GetTermFreq() const
+    {
+        return term_freqs_[current_->code];
+    }
+
+    //Наибольшая TF всех вхождений курсора
+    double GetMaxTermFreq() const
+    {
+        return max_term_freq_;
+    }
+
+    void Next()
+    {
+        if (++current_ == end_ && block_ != blocks_end_)
+        {
+            LoadBlock(block_ + 1);
+        }
+    }
+
+    //Переходит к первому вхождению с номером не меньше ordinal
+    void Seek(int ordinal)
+    {
+        if (GetOrdinal() >= ordinal)
+        {
+            return;
+        }
+        if (block_ != blocks_end_ && block_->last_ordinal < ordinal)
+        {
+            LoadBlock(FindBlock(block_ + 1, ordinal));
+        }
+        current_ = FindPosting(ordinal);
+    }
+
+    //Находит без распаковки блок, в котором может быть вхождение с номером ordinal. Номера вызовов не должны
+    //убывать. Если курсор уже дальше ordinal, находится блок текущего вхождения: между ними вхождений нет
+    void SeekBlock(int ordinal)
+    {
+        if (ordinal <= block_last_ordinal_)
+        {
+            return;
+        }
+        if (tail_)
+        {
+            //Блоком хвоста считаются BLOCK_SIZE вхождений начиная с первого подходящего
+            const EncodedPosting* posting = FindPosting(ordinal);
+            const EncodedPosting* last = posting + std::min<size_t>(BLOCK_SIZE, end_ - posting);
+            block_last_ordinal_ = posting != end_ ? (last - 1)->ordinal : END;
+            block_max_term_freq_ = 0.0;
+            for (; posting != last; ++posting)
+            {
+                block_max_term_freq_ = std::max(block_max_term_freq_, term_freqs_[posting->code]);
+            }
+            return;
+        }
+        const PostingBlock* block = FindBlock(block_, ordinal);
+        block_last_ordinal_ = block != blocks_end_ ? block->last_ordinal : END;
+        block_max_term_freq_ = block != blocks_end_ ? block->max_term_freq : 0.0;
+    }
+
+    //Последний номер блока, найденного SeekBlock, или END, если вхождений с таким номером нет
+    int GetBlockLastOrdinal() const
+    {
+        return block_last_ordinal_;
+    }
+
+    //Наибольшая TF блока, найденного SeekBlock, или 0, если вхождений с таким номером нет
+    double GetBlockMaxTermFreq() const
+    {
+        return block_max_term_freq_;
+    }
+
+private:
+    const PostingIndex* index_ = nullptr;
+    const double* term_freqs_ = nullptr;
+    const PostingBlock* blocks_begin_ = nullptr;
+    const PostingBlock* blocks_end_ = nullptr;
+    const PostingBlock* block_ = nullptr;                   //Распакованный в buffer_ блок
+    std::unique_ptr<EncodedPosting[]> buffer_;
+    const EncodedPosting* current_ = nullptr;
+    const EncodedPosting* end_ = nullptr;
+    bool tail_ = false;
+    double max_term_freq_ = 0.0;
+    int block_last_ordinal_ = -1;
+    double block_max_term_freq_ = 0.0;
+
+    //Первый элемент [from, end), для которого less(элемент, ordinal) ложно. Обычно он недалеко, поэтому
+    //шаг сначала удваивается, и только найденный отрезок просматривается двоичным поиском
+    template <typename T, typename Less>
+    static const T* Gallop(const T* from, const T* end, int ordinal, Less less)
+    {
+        if (from == end || !less(*from, ordinal))
+        {
+            return from;
+        }
+        size_t step = 1;
+        while (static_cast<size_t>(end - from) > step && less(from[step], ordinal))
+        {
+            from += step;
+            step *= 2;
+        }
+        return std::lower_bound(from + 1, static_cast<size_t>(end - from) > step ? from + step + 1 : end, ordinal, less);
+    }
+
+    //Первый блок из [from, blocks_end_) с last_ordinal не меньше ordinal
+    const PostingBlock* FindBlock(const PostingBlock* from, int ordinal) const
+    {
+        return Gallop(from, blocks_end_, ordinal,
+            [](const PostingBlock& block, int ordinal)
+            {
+                return block.last_ordinal < ordinal;
+            });
+    }
+
+    //Первое вхождение из [current_, end_) с номером не меньше ordinal
+    const EncodedPosting* FindPosting(int ordinal) const
+    {
+        return Gallop(current_, end_, ordinal,
+            [](const EncodedPosting& posting, int ordinal)
+            {
+                return posting.ordinal < ordinal;
+            });
+    }
+
+    void LoadBlock(const PostingBlock* block);
+};
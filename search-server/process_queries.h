@@ -1,14 +1,23 @@
 #pragma once
 #include "search_server.h"
 #include "document.h"
+#include "batch_results.h"
 
 #include<vector>
 #include<execution>
 #include<algorithm>
 #include<string>
-#include<deque>
 #include<utility>
 
-std::vector<std::vector<Document>> ProcessQueries(const SearchServer& search_server, const std::vector<std::string>& queries);
+//Выдачи всех запросов в одном буфере, см. BatchResults
+BatchResults ProcessQueries(const SearchServer& search_server, const std::vector<std::string>& queries);
 
-std::deque<Document> ProcessQueriesJoined(const SearchServer& search_server, const std::vector<std::string>& queries);
\ No newline at end of file
+//Выдачи передаются visitor(номер запроса, BatchResults::Range) по мере готовности, не по порядку запросов, без складывания в буфер
+template <typename Visitor>
+void ProcessQueries(const SearchServer& search_server, const std::vector<std::string>& queries, Visitor visitor)
+{
+    search_server.VisitTopDocumentsBatch(std::execution::par, queries, visitor);
+}
+
+//Документы всех выдач подряд. Буфер забирается у BatchResults, документы не копируются
+std::vector<Document> ProcessQueriesJoined(const SearchServer& search_server, const std::vector<std::string>& queries);
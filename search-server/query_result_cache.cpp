@@ -0,0 +1,129 @@
+#include "query_result_cache.h"
+#include <thread>
+#include <algorithm>
+#include <functional>
+
+using namespace std;
+
+QueryResultCache::QueryResultCache(size_t capacity, size_t shard_count)
+{
+    if (shard_count == 0)
+    {
+        shard_count = max(1u, thread::hardware_concurrency()) * 4;
+    }
+    shard_count = max<size_t>(1, min(shard_count, capacity));
+    shards_ = vector<Shard>(shard_count);
+    shard_capacity_ = (capacity + shard_count - 1) / shard_count;
+}
+
+vector<Document> QueryResultCache::FindTopDocuments(const SearchServer& search_server, string_view raw_query, DocumentStatus status, size_t top_k)
+{
+    return FindTopDocumentsImpl(execution::seq, search_server, raw_query, status, top_k);
+}
+
+vector<Document> QueryResultCache::FindTopDocuments(execution::sequenced_policy policy, const SearchServer& search_server, string_view raw_query, DocumentStatus status, size_t top_k)
+{
+    return FindTopDocumentsImpl(policy, search_server, raw_query, status, top_k);
+}
+
+vector<Document> QueryResultCache::FindTopDocuments(execution::parallel_policy policy, const SearchServer& search_server, string_view raw_query, DocumentStatus status, size_t top_k)
+{
+    return FindTopDocumentsImpl(policy, search_server, raw_query, status, top_k);
+}
+
+template <typename ExecutionPolicy>
+vector<Document> QueryResultCache::FindTopDocumentsImpl(ExecutionPolicy policy, const SearchServer& search_server, string_view raw_query,
+    DocumentStatus status, size_t top_k)
+{
+    const SearchServer::Query query = search_server.ParseNormalizedQuery(raw_query);
+    string key;
+    SearchServer::AppendQueryKey(query, key);
+    key.push_back(static_cast<char>(status));
+    key.append(reinterpret_cast<const char*>(&top_k), sizeof(top_k));
+
+    const uint64_t generation = search_server.GetGeneration();
+    Shard& shard = GetShard(key);
+    vector<Document> documents;
+    if (Find(shard, key, generation, documents))
+    {
+        return documents;
+    }
+
+    documents = search_server.FindAllDocuments(policy, search_server.ResolveQuery(query),
+        [status](int document_id, DocumentStatus document_status, int rating) { return document_status == status; },
+        top_k);
+    Insert(shard, key, generation, documents);
+    return documents;
+}
+
+QueryResultCache::Shard& QueryResultCache::GetShard(const string& key)
+{
+    return shards_[hash<string>()(key) % shards_.size()];
+}
+
+bool QueryResultCache::Find(Shard& shard, const string& key, uint64_t generation, vector<Document>& documents)
+{
+    lock_guard guard(shard.mutex);
+    const auto it = shard.index.find(key);
+    if (it == shard.index.end())
+    {
+        ++misses_;
+        return false;
+    }
+    if (it->second->generation != generation)
+    {
+        ++misses_;
+        ++invalidations_;
+        return false;
+    }
+    shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+    documents = it->second->documents;
+    ++hits_;
+    return true;
+}
+
+void QueryResultCache::Insert(Shard& shard, const string& key, uint64_t generation, const vector<Document>& documents)
+{
+    if (shard_capacity_ == 0)
+    {
+        return;
+    }
+    lock_guard guard(shard.mutex);
+    const auto it = shard.index.find(key);
+    if (it != shard.index.end())
+    {
+        //Устаревшая запись или запрос, посчитанный другим потоком одновременно с нами
+        it->second->generation = generation;
+        it->second->documents = documents;
+        shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+        return;
+    }
+    if (shard.entries.size() >= shard_capacity_)
+    {
+        shard.index.erase(shard.entries.back().key);
+        shard.entries.pop_back();
+        ++evictions_;
+    }
+    shard.entries.push_front(Entry{ key, generation, documents });
+    shard.index.emplace(shard.entries.front().key, shard.entries.begin());
+}
+
+QueryResultCacheStats QueryResultCache::GetStats() const
+{
+    QueryResultCacheStats stats;
+    stats.hits = hits_;
+    stats.misses = misses_;
+    stats.invalidations = invalidations_;
+    stats.evictions = evictions_;
+    return stats;
+}
+
+void QueryResultCache::Clear()
+{
+    for (Shard& shard : shards_)
+    {
+        lock_guard guard(shard.mutex);
+        shard.index.clear();
+        shard.entries.clear();
+    }
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include "search_server.h"
+#include <vector>
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <execution>
+#include <cstdint>
+
+struct QueryResultCacheStats
+{
+    uint64_t hits = 0;
+    uint64_t misses = 0;            //Включая устаревшие записи
+    uint64_t invalidations = 0;     //Запись нашлась, но индекс с тех пор изменился
+    uint64_t evictions = 0;         //Вытеснены из заполненного шарда
+};
+
+//Кэш выдачи FindTopDocuments по статусу. Ключ - нормализованный запрос (плюс- и минус-слова по возрастанию
+//без повторов), статус и top_k, так что запросы, отличающиеся порядком или повтором слов, делят запись.
+//Запись помнит номер состояния индекса (SearchServer::GetGeneration) и считается устаревшей, если индекс изменился.
+//Записи распределены по шардам со своей блокировкой и вытесняются из шарда по LRU. Выдача при промахе считается
+//без блокировки, поэтому одновременные промахи по одному запросу могут посчитать его дважды
+class QueryResultCache
+{
+public:
+    //capacity - наибольшее число записей, shard_count - число шардов (0 - по числу потоков)
+    explicit QueryResultCache(size_t capacity, size_t shard_count = 0);
+
+    std::vector<Document> FindTopDocuments(const SearchServer& search_server, std::string_view raw_query,
+        DocumentStatus status = DocumentStatus::ACTUAL, size_t top_k = MAX_RESULT_DOCUMENT_COUNT);
+    std::vector<Document> FindTopDocuments(std::execution::sequenced_policy policy, const SearchServer& search_server, std::string_view raw_query,
+        DocumentStatus status = DocumentStatus::ACTUAL, size_t top_k = MAX_RESULT_DOCUMENT_COUNT);
+    std::vector<Document> FindTopDocuments(std::execution::parallel_policy policy, const SearchServer& search_server, std::string_view raw_query,
+        DocumentStatus status = DocumentStatus::ACTUAL, size_t top_k = MAX_RESULT_DOCUMENT_COUNT);
+
+    QueryResultCacheStats GetStats() const;
+
+    //Удаляет все записи, статистика сохраняется
+    void Clear();
+
+private:
+    struct Entry
+    {
+        std::string key;
+        uint64_t generation = 0;
+        std::vector<Document> documents;
+    };
+
+    struct alignas(64) Shard
+    {
+        std::mutex mutex;
+        std::list<Entry> entries;                                           //От недавно использованных к давним
+        std::unordered_map<std::string_view, std::list<Entry>::iterator> index;   //Ключи смотрят в entries
+    };
+
+    std::vector<Shard> shards_;
+    size_t shard_capacity_ = 0;
+    std::atomic<uint64_t> hits_{ 0 };
+    std::atomic<uint64_t> misses_{ 0 };
+    std::atomic<uint64_t> invalidations_{ 0 };
+    std::atomic<uint64_t> evictions_{ 0 };
+
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocumentsImpl(ExecutionPolicy policy, const SearchServer& search_server, std::string_view raw_query,
+        DocumentStatus status, size_t top_k);
+
+    Shard& GetShard(const std::string& key);
+
+    //Выдача из кэша, если запись есть и посчитана на том же состоянии индекса
+    bool Find(Shard& shard, const std::string& key, uint64_t generation, std::vector<Document>& documents);
+
+    void Insert(Shard& shard, const std::string& key, uint64_t generation, const std::vector<Document>& documents);
+};
@@ -0,0 +1,76 @@
+#pragma once
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <cstdint>
+
+//Указатель на неизменяемое значение в духе RCU: читатели получают текущее значение без блокировок,
+//писатель подменяет его целиком. Старое значение живёт, пока его держит хоть один читатель.
+//Читатель отмечается в счётчике текущей эпохи только на время копирования shared_ptr,
+//писатель после подмены переключает эпоху и ждёт, пока счётчик старой эпохи не опустеет
+template <typename T>
+class RcuPointer
+{
+public:
+    explicit RcuPointer(std::shared_ptr<const T> value)
+        : current_(new std::shared_ptr<const T>(std::move(value)))
+    {
+    }
+
+    ~RcuPointer()
+    {
+        delete current_.load();
+    }
+
+    RcuPointer(const RcuPointer&) = delete;
+    RcuPointer& operator=(const RcuPointer&) = delete;
+
+    std::shared_ptr<const T> Load() const
+    {
+        while (true)
+        {
+            const uint64_t epoch = epoch_.load();
+            ReaderCount& readers = readers_[epoch % 2];
+            readers.count.fetch_add(1);
+            //Если эпоха успела смениться, писатель мог уже не увидеть нашу отметку
+            if (epoch_.load() != epoch)
+            {
+                readers.count.fetch_sub(1);
+                continue;
+            }
+            std::shared_ptr<const T> value = *current_.load();
+            readers.count.fetch_sub(1);
+            return value;
+        }
+    }
+
+    void Store(std::shared_ptr<const T> value)
+    {
+        const std::shared_ptr<const T>* old = nullptr;
+        {
+            std::lock_guard guard(write_mutex_);
+            old = current_.exchange(new std::shared_ptr<const T>(std::move(value)));
+            const uint64_t epoch = epoch_.fetch_add(1);
+            //Старый указатель могли прочитать только читатели, отметившиеся в старой эпохе
+            while (readers_[epoch % 2].count.load() != 0)
+            {
+                std::this_thread::yield();
+            }
+        }
+        //Значение освобождается вне блокировки: деструктор большого индекса не задерживает следующего писателя
+        delete old;
+    }
+
+private:
+    //Счётчики на разных кэш-линиях, чтобы читатели двух эпох не мешали друг другу
+    struct alignas(64) ReaderCount
+    {
+        std::atomic<int64_t> count{ 0 };
+    };
+
+    std::atomic<const std::shared_ptr<const T>*> current_;
+    std::atomic<uint64_t> epoch_{ 0 };
+    mutable ReaderCount readers_[2];
+    std::mutex write_mutex_;
+};
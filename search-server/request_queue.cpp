@@ -9,16 +9,29 @@ RequestQueue::RequestQueue(const SearchServer& search_server)
 
 int RequestQueue::GetNoResultRequests() const
 {
-    // напишите реализацию
-    int empty_results = 0;
-    for (auto it = requests_.begin(); it != requests_.end(); it = next(it))
+    lock_guard guard(mutex_);
+    return no_result_requests_;
+}
+
+const RequestStatistics& RequestQueue::GetStatistics() const
+{
+    return statistics_;
+}
+
+void RequestQueue::AddRequest(size_t result_count)
+{
+    lock_guard guard(mutex_);
+    MinsCheck();
+    MoveDeque();
+
+    QueryResult result;
+    result.request_time = current_mins_;
+    result.results = static_cast<int>(result_count);
+    requests_.push_back(result);
+    if (result.results == 0)
     {
-        if (it->results == 0)
-        {
-            empty_results += 1;
-        }
+        ++no_result_requests_;
     }
-    return empty_results;
 }
 
 void RequestQueue::MinsCheck()
@@ -38,6 +51,10 @@ void RequestQueue::MoveDeque()
 {
     if (day_)
     {
+        if (requests_.front().results == 0)
+        {
+            --no_result_requests_;
+        }
         requests_.pop_front();
     }
 }
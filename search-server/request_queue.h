@@ -1,9 +1,13 @@
 #pragma once
 #include <deque>
 #include <vector>
+#include <mutex>
 #include "search_server.h"
+#include "request_statistics.h"
 
 
+//Очередь последних min_in_day_ запросов (запрос - условная минута) и статистика запросов в окнах реального времени.
+//Запросы можно добавлять из нескольких потоков
 class RequestQueue
 {
 public:
@@ -17,8 +21,12 @@ public:
 
     std::vector<Document> AddFindRequest(const std::string& raw_query);
 
+    //Запросы с пустой выдачей среди последних min_in_day_, за O(1)
     int GetNoResultRequests() const;
 
+    //Число запросов, размеры выдачи и задержки за последнюю минуту, час и сутки
+    const RequestStatistics& GetStatistics() const;
+
 private:
     struct QueryResult
     {
@@ -31,26 +39,26 @@ private:
     int current_mins_ = 0;
     const SearchServer& search_server_;
     bool day_ = false;
+    int no_result_requests_ = 0;
+    mutable std::mutex mutex_;                  //Для requests_ и счётчиков условных минут
+    RequestStatistics statistics_;
 
     void MinsCheck();
 
     void MoveDeque();
 
+    void AddRequest(size_t result_count);
+
 };
 
 
 template <typename DocumentPredicate>
 std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate)
 {
-    // напишите реализацию
+    const RequestStatistics::Clock::time_point start = RequestStatistics::Clock::now();
     std::vector<Document> vec = search_server_.FindTopDocuments(raw_query, document_predicate);
-    MinsCheck();
-    MoveDeque();
-
-    QueryResult result;
-    result.request_time = current_mins_;
-    result.results = vec.size();
-    requests_.push_back(result);
-
+    const RequestStatistics::Clock::time_point finish = RequestStatistics::Clock::now();
+    statistics_.Record(finish - start, vec.size(), finish);
+    AddRequest(vec.size());
     return vec;
 }
\ No newline at end of file
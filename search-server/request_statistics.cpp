@@ -0,0 +1,95 @@
+#include "request_statistics.h"
+#include <iterator>
+
+using namespace std;
+
+RequestStatistics::RequestStatistics()
+{
+    const pair<Clock::duration, size_t> layouts[] = {
+        { chrono::seconds(1), 60 },
+        { chrono::minutes(1), 60 },
+        { chrono::hours(1), 24 }
+    };
+    for (size_t window = 0; window < size(layouts); ++window)
+    {
+        rings_[window].slot_duration = layouts[window].first;
+        rings_[window].slot_count = layouts[window].second;
+        rings_[window].slots.reset(new Slot[layouts[window].second]);
+    }
+}
+
+void RequestStatistics::Record(Clock::duration latency, size_t result_count, Clock::time_point now)
+{
+    const uint64_t latency_ns = static_cast<uint64_t>(max<int64_t>(0, chrono::duration_cast<chrono::nanoseconds>(latency).count()));
+    for (Ring& ring : rings_)
+    {
+        Slot* slot = GetSlot(ring, GetPeriod(ring, now));
+        if (!slot)
+        {
+            continue;
+        }
+        slot->request_count.fetch_add(1, memory_order_relaxed);
+        if (result_count == 0)
+        {
+            slot->no_result_count.fetch_add(1, memory_order_relaxed);
+        }
+        slot->result_count.fetch_add(result_count, memory_order_relaxed);
+        slot->latencies.Add(latency_ns);
+    }
+}
+
+RequestStatistics::WindowStats RequestStatistics::GetStats(Window window, Clock::time_point now) const
+{
+    const Ring& ring = rings_[static_cast<size_t>(window)];
+    const int64_t current_period = GetPeriod(ring, now);
+    WindowStats stats;
+    for (size_t i = 0; i < ring.slot_count; ++i)
+    {
+        const Slot& slot = ring.slots[i];
+        const int64_t period = slot.period.load(memory_order_acquire);
+        if (period > current_period || period <= current_period - static_cast<int64_t>(ring.slot_count))
+        {
+            continue;
+        }
+        stats.request_count += slot.request_count.load(memory_order_relaxed);
+        stats.no_result_count += slot.no_result_count.load(memory_order_relaxed);
+        stats.result_count += slot.result_count.load(memory_order_relaxed);
+        stats.latencies.Merge(slot.latencies);
+    }
+    return stats;
+}
+
+int64_t RequestStatistics::GetPeriod(const Ring& ring, Clock::time_point time)
+{
+    return time.time_since_epoch() / ring.slot_duration;
+}
+
+RequestStatistics::Slot* RequestStatistics::GetSlot(Ring& ring, int64_t period)
+{
+    Slot& slot = ring.slots[static_cast<size_t>(period) % ring.slot_count];
+    int64_t slot_period = slot.period.load(memory_order_acquire);
+    if (slot_period == period)
+    {
+        return &slot;
+    }
+    if (slot_period > period)
+    {
+        return nullptr;
+    }
+
+    lock_guard guard(ring.rotation_mutex);
+    slot_period = slot.period.load(memory_order_relaxed);
+    if (slot_period < period)
+    {
+        slot.request_count.store(0, memory_order_relaxed);
+        slot.no_result_count.store(0, memory_order_relaxed);
+        slot.result_count.store(0, memory_order_relaxed);
+        slot.latencies.Reset();
+        slot.period.store(period, memory_order_release);
+    }
+    else if (slot_period > period)
+    {
+        return nullptr;
+    }
+    return &slot;
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include "latency_histogram.h"
+#include <chrono>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+#include <cstddef>
+
+//Статистика запросов в скользящих окнах реального времени: последняя минута, час и сутки.
+//Окно - кольцо ячеек (60 секунд, 60 минут, 24 часа), запрос попадает в ячейку текущего периода, поэтому
+//запись стоит O(1) атомарных сложений, а окно сдвигается само, когда ячейка достаётся новому периоду.
+//Окно покрывает свою длину с точностью до одной ячейки. Record и GetStats можно вызывать из любых потоков;
+//запрос, записанный ровно в момент перехода ячейки к новому периоду, может попасть в соседний период
+class RequestStatistics
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    enum class Window
+    {
+        MINUTE,
+        HOUR,
+        DAY
+    };
+
+    struct WindowStats
+    {
+        uint64_t request_count = 0;
+        uint64_t no_result_count = 0;               //Запросы с пустой выдачей
+        uint64_t result_count = 0;                  //Сумма размеров выдачи
+        LatencyHistogram latencies;                 //Наносекунды
+
+        uint64_t GetLatencyPercentile(double quantile) const
+        {
+            return latencies.GetPercentile(quantile);
+        }
+    };
+
+    RequestStatistics();
+
+    void Record(Clock::duration latency, size_t result_count, Clock::time_point now = Clock::now());
+
+    WindowStats GetStats(Window window, Clock::time_point now = Clock::now()) const;
+
+private:
+    struct Slot
+    {
+        std::atomic<int64_t> period{ -1 };          //Номер периода, который сейчас копится в ячейке
+        std::atomic<uint64_t> request_count{ 0 };
+        std::atomic<uint64_t> no_result_count{ 0 };
+        std::atomic<uint64_t> result_count{ 0 };
+        LatencyHistogram latencies;
+    };
+
+    struct Ring
+    {
+        Clock::duration slot_duration{};
+        size_t slot_count = 0;
+        std::unique_ptr<Slot[]> slots;
+        std::mutex rotation_mutex;                  //Только на смену периода ячейки
+    };
+
+    Ring rings_[3];
+
+    static int64_t GetPeriod(const Ring& ring, Clock::time_point time);
+
+    //Ячейка периода. nullptr, если ячейка уже занята более новым периодом
+    static Slot* GetSlot(Ring& ring, int64_t period);
+};
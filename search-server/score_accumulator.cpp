@@ -0,0 +1,48 @@
+#include "score_accumulator.h"
+#include <algorithm>
+
+using namespace std;
+
+void ScoreAccumulator::Reset(size_t ordinal_count, size_t part_count)
+{
+    if (relevances_.size() < ordinal_count)
+    {
+        relevances_.resize(ordinal_count);
+        stamps_.resize(ordinal_count, 0);
+    }
+    if (touched_.size() < part_count)
+    {
+        touched_.resize(part_count);
+    }
+    for (size_t part = 0; part < part_count; ++part)
+    {
+        touched_[part].clear();
+    }
+
+    ++epoch_;
+    if (epoch_ == 0)
+    {
+        fill(stamps_.begin(), stamps_.end(), 0);
+        epoch_ = 1;
+    }
+}
+
+void BatchScoreAccumulator::Reset(size_t ordinal_count)
+{
+    if (states_.size() < ordinal_count)
+    {
+        states_.resize(ordinal_count);
+        relevances_.resize(ordinal_count * LANE_COUNT);
+    }
+    for (vector<int>& touched : touched_)
+    {
+        touched.clear();
+    }
+
+    ++epoch_;
+    if (epoch_ == 0)
+    {
+        fill(states_.begin(), states_.end(), OrdinalState());
+        epoch_ = 1;
+    }
+}
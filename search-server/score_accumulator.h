@@ -0,0 +1,151 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+//Накопитель релевантности запроса в плотных массивах, индексированных порядковым номером документа.
+//Массивы не очищаются между запросами: документ считается задетым текущим запросом, только если его
+//метка совпадает с эпохой запроса. Для параллельного подсчёта диапазон номеров делится на части,
+//каждая часть пишет только в свои ячейки и ведёт собственный список задетых документов.
+//Накопители берутся через ThreadScratch: вложенный запрос в том же потоке получает другой экземпляр
+class ScoreAccumulator
+{
+public:
+    //Готовит накопитель к новому запросу по документам с номерами [0, ordinal_count)
+    void Reset(size_t ordinal_count, size_t part_count = 1);
+
+    //Прибавляет релевантность документу. При первом касании документа спрашивает accept, подходит ли он
+    template <typename Accept>
+    void Add(size_t part, int ordinal, double relevance, Accept accept)
+    {
+        if (stamps_[ordinal] != epoch_)
+        {
+            stamps_[ordinal] = epoch_;
+            relevances_[ordinal] = accept(ordinal) ? 0.0 : REJECTED;
+            touched_[part].push_back(ordinal);
+        }
+        if (relevances_[ordinal] != REJECTED)
+        {
+            relevances_[ordinal] += relevance;
+        }
+    }
+
+    //Обходит подошедшие документы части в порядке первого касания
+    template <typename Function>
+    void ForEachDocument(size_t part, Function function) const
+    {
+        for (int ordinal : touched_[part])
+        {
+            if (relevances_[ordinal] != REJECTED)
+            {
+                function(ordinal, relevances_[ordinal]);
+            }
+        }
+    }
+
+private:
+    //Релевантность не бывает отрицательной, поэтому отрицательное значение помечает отброшенный документ
+    static constexpr double REJECTED = -1.0;
+
+    std::vector<double> relevances_;
+    std::vector<uint32_t> stamps_;
+    std::vector<std::vector<int>> touched_;
+    uint32_t epoch_ = 0;
+};
+
+//Накопитель для нескольких запросов сразу: запросы пачки, у которых есть общие слова, считаются за один проход
+//по спискам вхождений. Релевантности запросов одного документа лежат рядом, в одной кэш-линии,
+//так что вхождение, нужное нескольким запросам, обходится почти так же дёшево, как нужное одному.
+//Запрос занимает дорожку, бит дорожки в маске говорит, к каким запросам относится слово
+class BatchScoreAccumulator
+{
+public:
+    static const size_t LANE_COUNT = 4;
+
+    void Reset(size_t ordinal_count);
+
+    //Прибавляет релевантность документу во всех дорожках маски. accept спрашивается один раз на документ
+    template <typename Accept>
+    void Add(uint32_t lane_mask, int ordinal, double relevance, Accept accept)
+    {
+        OrdinalState& state = Touch(ordinal);
+        if (state.acceptance == UNKNOWN)
+        {
+            state.acceptance = accept(ordinal) ? ACCEPTED : NOT_ACCEPTED;
+        }
+        double* relevances = &relevances_[static_cast<size_t>(ordinal) * LANE_COUNT];
+        for (uint32_t mask = lane_mask; mask != 0; mask &= mask - 1)
+        {
+            const size_t lane = CountTrailingZeros(mask);
+            if (!(state.touched_lanes & (1u << lane)))
+            {
+                state.touched_lanes |= 1u << lane;
+                relevances[lane] = state.acceptance == ACCEPTED ? 0.0 : REJECTED;
+                touched_[lane].push_back(ordinal);
+            }
+            if (relevances[lane] != REJECTED)
+            {
+                relevances[lane] += relevance;
+            }
+        }
+    }
+
+    //Обходит подошедшие документы дорожки в порядке первого касания, как ScoreAccumulator::ForEachDocument
+    template <typename Function>
+    void ForEachDocument(size_t lane, Function function) const
+    {
+        for (int ordinal : touched_[lane])
+        {
+            const double relevance = relevances_[static_cast<size_t>(ordinal) * LANE_COUNT + lane];
+            if (relevance != REJECTED)
+            {
+                function(ordinal, relevance);
+            }
+        }
+    }
+
+private:
+    static constexpr double REJECTED = -1.0;
+
+    enum Acceptance : uint8_t
+    {
+        UNKNOWN,
+        ACCEPTED,
+        NOT_ACCEPTED
+    };
+
+    struct OrdinalState
+    {
+        uint32_t stamp = 0;
+        uint8_t touched_lanes = 0;
+        Acceptance acceptance = UNKNOWN;
+    };
+
+    std::vector<OrdinalState> states_;
+    std::vector<double> relevances_;                //Номер документа * LANE_COUNT + дорожка
+    std::vector<int> touched_[LANE_COUNT];
+    uint32_t epoch_ = 0;
+
+    OrdinalState& Touch(int ordinal)
+    {
+        OrdinalState& state = states_[ordinal];
+        if (state.stamp != epoch_)
+        {
+            state.stamp = epoch_;
+            state.touched_lanes = 0;
+            state.acceptance = UNKNOWN;
+        }
+        return state;
+    }
+
+    static size_t CountTrailingZeros(uint32_t mask)
+    {
+        size_t count = 0;
+        while (!(mask & 1))
+        {
+            mask >>= 1;
+            ++count;
+        }
+        return count;
+    }
+};
@@ -3,6 +3,7 @@
 #include "log_duration.h"
 #include <cmath>
 #include <unordered_set>
+#include <atomic>
 
 using namespace std;
 
@@ -19,7 +20,7 @@ SearchServer::SearchServer(const string& stop_words)
     }
     for (const string& word : stop_words_vector)
     {
-        SearchServer::stop_words_.insert(word);
+        SearchServer::stop_words_.Add(word);
     }
 }
 
@@ -35,7 +36,7 @@ SearchServer::SearchServer(string_view stop_words)
     }
     for (string_view word : stop_words_vector)
     {
-        SearchServer::stop_words_.insert(string(word));
+        SearchServer::stop_words_.Add(word);
     }
 }
 
@@ -43,8 +44,9 @@ void SearchServer::SetStopWords(const string& text)
 {
     for (const string& word : SplitIntoWords(text))
     {
-        SearchServer::stop_words_.insert(word);
+        SearchServer::stop_words_.Add(word);
     }
+    generation_ = NextGeneration();
 }
 
 void SearchServer::AddDocument(int document_id, const string_view document, DocumentStatus status, const vector<int>& ratings)
@@ -57,58 +59,506 @@ void SearchServer::AddDocument(int document_id, const string_view document, Docu
     {
         throw invalid_argument("id value should not be less than 0");
     }
-    else if (!SearchServer::IsValidString(document))
+
+    const WordFrequencies word_freqs = ComputeWordFrequencies(SearchServer::SplitIntoWordsNoStop(document));
+    const uint64_t fingerprint = ComputeFingerprint(word_freqs);
+    const bool is_duplicate = IsDuplicate(fingerprint, word_freqs);
+    if (is_duplicate && duplicate_policy_ == DuplicatePolicy::REJECT)
     {
-        throw invalid_argument("Forbidden symbols");
+        throw invalid_argument("duplicate document");
+    }
+
+    vector<pair<size_t, Posting>> postings;
+    RegisterDocument(document_id, status, ComputeAverageRating(ratings), word_freqs, fingerprint, postings);
+    if (is_duplicate)
+    {
+        reported_duplicates_.push_back(document_id);
+    }
+    for (const auto& [term, posting] : postings)
+    {
+        posting_index_.Add(term, posting.ordinal, posting.term_freq);
+        UpdateTermDocumentFreq(term);
     }
+    UpdateDocumentCount();
+}
+
+vector<AddDocumentError> SearchServer::AddDocuments(const vector<NewDocument>& documents)
+{
+    return AddDocuments(execution::seq, documents);
+}
+
+vector<AddDocumentError> SearchServer::AddDocuments(execution::sequenced_policy policy, const vector<NewDocument>& documents)
+{
+    return AddDocumentsBatch(policy, documents);
+}
 
-    const auto [it, inserted] = documents_.emplace(document_id,
-        DocumentData
+vector<AddDocumentError> SearchServer::AddDocuments(execution::parallel_policy policy, const vector<NewDocument>& documents)
+{
+    return AddDocumentsBatch(policy, documents);
+}
+
+template <typename ExecutionPolicy>
+vector<AddDocumentError> SearchServer::AddDocumentsBatch(ExecutionPolicy policy, const vector<NewDocument>& documents)
+{
+    //Разбор текстов и подсчёт частот не трогают индекс, поэтому идут параллельно
+    vector<optional<WordFrequencies>> documents_word_freqs(documents.size());
+    transform(
+        policy,
+        documents.begin(), documents.end(),
+        documents_word_freqs.begin(),
+        [this](const NewDocument& document) -> optional<WordFrequencies>
         {
-            ComputeAverageRating(ratings),
-            status,
-            string(document)
+            vector<string_view> words;
+            if (!SplitIntoWordsChecked(document.text, stop_words_, words))
+            {
+                return nullopt;
+            }
+            return ComputeWordFrequencies(move(words));
         });
 
-    const vector<string_view> words = SearchServer::SplitIntoWordsNoStop(it->second.raw_text);
+    //Регистрация документов и выдача id словам идут по порядку пачки, вхождения копятся и сливаются в индекс разом
+    vector<AddDocumentError> errors;
+    vector<pair<size_t, Posting>> postings;
+    for (size_t index = 0; index < documents.size(); ++index)
+    {
+        const NewDocument& document = documents[index];
+        if (documents_.count(document.id) == 1)
+        {
+            errors.push_back({ index, document.id, "id is taken" });
+        }
+        else if (document.id < 0)
+        {
+            errors.push_back({ index, document.id, "id value should not be less than 0" });
+        }
+        else if (!documents_word_freqs[index])
+        {
+            errors.push_back({ index, document.id, "Forbidden symbols" });
+        }
+        else
+        {
+            const WordFrequencies& word_freqs = *documents_word_freqs[index];
+            const uint64_t fingerprint = ComputeFingerprint(word_freqs);
+            const bool is_duplicate = IsDuplicate(fingerprint, word_freqs);
+            if (is_duplicate && duplicate_policy_ == DuplicatePolicy::REJECT)
+            {
+                errors.push_back({ index, document.id, "duplicate document" });
+                continue;
+            }
+            RegisterDocument(document.id, document.status, ComputeAverageRating(document.ratings), word_freqs, fingerprint, postings);
+            if (is_duplicate)
+            {
+                reported_duplicates_.push_back(document.id);
+            }
+        }
+    }
+
+    IndexPostings(postings);
+    return errors;
+}
+
+void SearchServer::IndexPostings(const vector<pair<size_t, Posting>>& postings)
+{
+    posting_index_.AddBatch(postings);
+    for (const auto& [term, posting] : postings)
+    {
+        UpdateTermDocumentFreq(term);
+    }
+    UpdateDocumentCount();
+}
+
+void SearchServer::AddDocumentsFrom(const SearchServer& other)
+{
+    for (const auto& [document_id, document] : other.documents_)
+    {
+        if (documents_.count(document_id) > 0)
+        {
+            throw invalid_argument("id is taken");
+        }
+    }
+
+    vector<pair<size_t, Posting>> postings;
+    WordFrequencies word_freqs;
+    for (size_t ordinal = 0; ordinal < other.ordinal_to_document_.size(); ++ordinal)
+    {
+        if (!other.IsLiveDocument(static_cast<int>(ordinal)))
+        {
+            continue;
+        }
+        const DocumentAttributes& document = other.ordinal_to_document_[ordinal];
+        word_freqs.clear();
+        other.forward_index_.ForEachTerm(static_cast<int>(ordinal),
+            [&](int term, double term_freq)
+            {
+                word_freqs.emplace_back(other.terms_.GetTerm(term), term_freq);
+            });
+        RegisterDocument(document.id, document.status, document.rating, word_freqs, other.documents_.at(document.id).fingerprint, postings);
+    }
+    IndexPostings(postings);
+}
+
+SearchServer::WordFrequencies SearchServer::ComputeWordFrequencies(vector<string_view> words)
+{
+    WordFrequencies word_freqs;
     const double inv_word_count = 1.0 / words.size();
+    sort(words.begin(), words.end());
     for (string_view word : words)
     {
-        word_to_document_freqs_[word][document_id] += inv_word_count;
-        ids_to_word_to_freqs[document_id][word] += inv_word_count;
-        ids_to_words_[document_id].insert(string(word));
+        if (word_freqs.empty() || word_freqs.back().first != word)
+        {
+            word_freqs.emplace_back(word, 0.0);
+        }
+        word_freqs.back().second += inv_word_count;
+    }
+    return word_freqs;
+}
+
+void SearchServer::RegisterDocument(int document_id, DocumentStatus status, int rating,
+    const WordFrequencies& word_freqs, uint64_t fingerprint, vector<pair<size_t, Posting>>& postings)
+{
+    const int ordinal = static_cast<int>(ordinal_to_document_.size());
+    documents_.Insert(document_id, DocumentData{ rating, status, ordinal, fingerprint });
+    if (duplicate_policy_ != DuplicatePolicy::ALLOW && !word_freqs.empty())
+    {
+        if (vector<int>* document_ids = fingerprint_to_documents_.FindMutable(fingerprint))
+        {
+            document_ids->push_back(document_id);
+        }
+        else
+        {
+            fingerprint_to_documents_.Insert(fingerprint, { document_id });
+        }
+    }
+    ordinal_to_document_.push_back({ document_id, rating, status });
+    if (live_documents_.size() * 64 <= static_cast<size_t>(ordinal))
+    {
+        live_documents_.push_back(0);
     }
-    documents_ids_.insert(document_id);
+    live_documents_.GetMutable(ordinal / 64) |= uint64_t(1) << (ordinal % 64);
 
+    vector<pair<int, double>> term_freqs;
+    term_freqs.reserve(word_freqs.size());
+    for (const auto& [word, term_freq] : word_freqs)
+    {
+        const int term = terms_.Intern(word);
+        if (static_cast<size_t>(term) == posting_index_.GetTermCount())
+        {
+            posting_index_.AddTerm();
+            term_document_counts_.push_back(0);
+            term_log_document_freqs_.push_back(0.0);
+        }
+        ++term_document_counts_.GetMutable(term);
+        term_freqs.emplace_back(term, term_freq);
+        postings.push_back({ static_cast<size_t>(term), Posting{ ordinal, term_freq } });
+    }
+    forward_index_.Add(move(term_freqs));
 }
 
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus check_status, size_t top_k) const
+{
+    return SearchServer::FindTopDocuments(raw_query, [check_status](int document_id, DocumentStatus status, int rating) { return status == check_status; }, top_k);
+}
 std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus check_status) const
 {
-    return SearchServer::FindTopDocuments(raw_query, [check_status](int document_id, DocumentStatus status, int rating) { return status == check_status; });
+    return SearchServer::FindTopDocuments(raw_query, check_status, MAX_RESULT_DOCUMENT_COUNT);
 }
 std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query) const
 {
     return SearchServer::FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
 }
 
+std::vector<Document> SearchServer::FindTopDocuments(execution::sequenced_policy policy, std::string_view raw_query, DocumentStatus check_status, size_t top_k) const
+{
+    return SearchServer::FindTopDocuments(raw_query, check_status, top_k);
+}
 std::vector<Document> SearchServer::FindTopDocuments(execution::sequenced_policy policy, std::string_view raw_query, DocumentStatus check_status) const
 {
-    return SearchServer::FindTopDocuments(raw_query, [check_status](int document_id, DocumentStatus status, int rating) { return status == check_status; });
+    return SearchServer::FindTopDocuments(raw_query, check_status, MAX_RESULT_DOCUMENT_COUNT);
 }
 std::vector<Document> SearchServer::FindTopDocuments(execution::sequenced_policy policy, std::string_view raw_query) const
 {
     return SearchServer::FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
 }
 
+std::vector<Document> SearchServer::FindTopDocuments(execution::parallel_policy policy, std::string_view raw_query, DocumentStatus check_status, size_t top_k) const
+{
+    return SearchServer::FindTopDocuments(policy, raw_query, [check_status](int document_id, DocumentStatus status, int rating) { return status == check_status; }, top_k);
+}
 std::vector<Document> SearchServer::FindTopDocuments(execution::parallel_policy policy, std::string_view raw_query, DocumentStatus check_status) const
 {
-    return SearchServer::FindTopDocuments(policy, raw_query, [check_status](int document_id, DocumentStatus status, int rating) { return status == check_status; });
+    return SearchServer::FindTopDocuments(policy, raw_query, check_status, MAX_RESULT_DOCUMENT_COUNT);
 }
 std::vector<Document> SearchServer::FindTopDocuments(execution::parallel_policy policy, std::string_view raw_query) const
 {
     return SearchServer::FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
 }
 
+BatchResults SearchServer::FindTopDocumentsBatch(const vector<string>& raw_queries, DocumentStatus status) const
+{
+    return FindTopDocumentsBatchFlat(execution::par, raw_queries, status);
+}
+
+BatchResults SearchServer::FindTopDocumentsBatch(execution::sequenced_policy policy, const vector<string>& raw_queries, DocumentStatus status) const
+{
+    return FindTopDocumentsBatchFlat(policy, raw_queries, status);
+}
+
+BatchResults SearchServer::FindTopDocumentsBatch(execution::parallel_policy policy, const vector<string>& raw_queries, DocumentStatus status) const
+{
+    return FindTopDocumentsBatchFlat(policy, raw_queries, status);
+}
+
+template <typename ExecutionPolicy>
+BatchResults SearchServer::FindTopDocumentsBatchFlat(ExecutionPolicy policy, const vector<string>& raw_queries, DocumentStatus status) const
+{
+    const BatchPlan plan = PlanTopDocumentsBatch(policy, raw_queries);
+
+    //Каждому запросу отводится место под MAX_RESULT_DOCUMENT_COUNT документов, и группы пишут выдачи прямо в буфер результата,
+    //на место первого из одинаковых запросов
+    vector<Document> documents(raw_queries.size() * MAX_RESULT_DOCUMENT_COUNT);
+    vector<size_t> sizes(raw_queries.size());
+    for_each(policy, plan.groups.begin(), plan.groups.end(),
+        [&](const vector<size_t>& group)
+        {
+            array<BatchSlot, BatchScoreAccumulator::LANE_COUNT> slots;
+            for (size_t lane = 0; lane < group.size(); ++lane)
+            {
+                slots[lane].documents = documents.data() + plan.query_indexes[group[lane]].front() * MAX_RESULT_DOCUMENT_COUNT;
+            }
+            FindTopDocumentsGroup(plan, group, status, slots.data());
+            for (size_t lane = 0; lane < group.size(); ++lane)
+            {
+                sizes[plan.query_indexes[group[lane]].front()] = slots[lane].size;
+            }
+        });
+
+    //Выдачи сдвигаются к началу буфера по порядку запросов. Выдача запроса не выходит за его место и не задевает места
+    //следующих, а повторный запрос копирует уже сдвинутую выдачу первого из одинаковых
+    vector<size_t> offsets(raw_queries.size() + 1, 0);
+    for (size_t i = 0; i < raw_queries.size(); ++i)
+    {
+        const size_t first = plan.query_indexes[plan.query_to_distinct[i]].front();
+        const auto source = documents.begin() + (first == i ? i * MAX_RESULT_DOCUMENT_COUNT : offsets[first]);
+        const auto destination = documents.begin() + offsets[i];
+        if (source != destination)
+        {
+            copy(source, source + sizes[first], destination);
+        }
+        offsets[i + 1] = offsets[i] + sizes[first];
+    }
+    documents.resize(offsets.back());
+    return BatchResults(move(documents), move(offsets));
+}
+
+template <typename ExecutionPolicy>
+SearchServer::BatchPlan SearchServer::PlanTopDocumentsBatch(ExecutionPolicy policy, const vector<string>& raw_queries) const
+{
+    vector<Query> queries(raw_queries.size());
+    transform(policy, raw_queries.begin(), raw_queries.end(), queries.begin(),
+        [this](const string& raw_query)
+        {
+            StageTimer timer(SearchStage::PARSE);
+            return ParseNormalizedQuery(raw_query);
+        });
+
+    //Одинаковые запросы выполняются один раз
+    BatchPlan plan;
+    vector<size_t>& query_to_distinct = plan.query_to_distinct;
+    query_to_distinct.resize(queries.size());
+    vector<const Query*> distinct_queries;
+    {
+        unordered_map<string, size_t> distinct_indexes;
+        string key;
+        for (size_t i = 0; i < queries.size(); ++i)
+        {
+            key.clear();
+            AppendQueryKey(queries[i], key);
+            const auto [it, inserted] = distinct_indexes.emplace(key, distinct_queries.size());
+            if (inserted)
+            {
+                distinct_queries.push_back(&queries[i]);
+                plan.query_indexes.emplace_back();
+            }
+            query_to_distinct[i] = it->second;
+            plan.query_indexes[it->second].push_back(i);
+        }
+    }
+
+    //Каждое слово пачки ищется в словаре один раз
+    vector<ResolvedQuery>& resolved_queries = plan.queries;
+    resolved_queries.resize(distinct_queries.size());
+    {
+        unordered_map<string_view, int> word_terms;
+        const auto find_term = [this, &word_terms](string_view word)
+        {
+            const auto [it, inserted] = word_terms.emplace(word, int{ TermDictionary::NO_TERM });
+            if (inserted)
+            {
+                it->second = FindIndexedTerm(word);
+            }
+            return it->second;
+        };
+        for (size_t i = 0; i < distinct_queries.size(); ++i)
+        {
+            for (string_view word : distinct_queries[i]->plus_words)
+            {
+                const int term = find_term(word);
+                if (term != TermDictionary::NO_TERM)
+                {
+                    resolved_queries[i].plus_terms.emplace_back(term, ComputeWordInverseDocumentFreq(term));
+                }
+            }
+            for (string_view word : distinct_queries[i]->minus_words)
+            {
+                const int term = find_term(word);
+                if (term != TermDictionary::NO_TERM)
+                {
+                    resolved_queries[i].minus_terms.push_back(term);
+                }
+            }
+        }
+    }
+
+    //Совместный проход окупается, когда у запросов общий самый длинный список вхождений:
+    //запросы группируются по нему, запрос без пары считается обычным образом
+    vector<pair<int, size_t>> lead_terms;
+    for (size_t i = 0; i < resolved_queries.size(); ++i)
+    {
+        const auto& plus_terms = resolved_queries[i].plus_terms;
+        if (plus_terms.empty())
+        {
+            continue;
+        }
+        const auto lead = max_element(plus_terms.begin(), plus_terms.end(),
+            [this](const pair<int, double>& lhs, const pair<int, double>& rhs)
+            {
+                return posting_index_.GetPostingCount(lhs.first) < posting_index_.GetPostingCount(rhs.first);
+            });
+        lead_terms.emplace_back(lead->first, i);
+    }
+    sort(lead_terms.begin(), lead_terms.end());
+
+    vector<vector<size_t>>& groups = plan.groups;
+    for (size_t i = 0; i < lead_terms.size(); ++i)
+    {
+        if (i == 0 || lead_terms[i].first != lead_terms[i - 1].first || groups.back().size() == BatchScoreAccumulator::LANE_COUNT)
+        {
+            groups.emplace_back();
+        }
+        groups.back().push_back(lead_terms[i].second);
+    }
+
+    return plan;
+}
+
+//VisitTopDocumentsBatch определён в заголовке и вызывает эти версии
+template SearchServer::BatchPlan SearchServer::PlanTopDocumentsBatch(execution::sequenced_policy, const vector<string>&) const;
+template SearchServer::BatchPlan SearchServer::PlanTopDocumentsBatch(execution::parallel_policy, const vector<string>&) const;
+
+void SearchServer::FindTopDocumentsGroup(const BatchPlan& plan, const vector<size_t>& group, DocumentStatus status, BatchSlot* slots) const
+{
+    if (group.size() == 1)
+    {
+        const vector<Document> documents = FindAllDocuments(execution::seq, plan.queries[group[0]],
+            [status](int document_id, DocumentStatus document_status, int rating) { return document_status == status; },
+            MAX_RESULT_DOCUMENT_COUNT);
+        slots[0].size = copy(documents.begin(), documents.end(), slots[0].documents) - slots[0].documents;
+        return;
+    }
+    vector<const ResolvedQuery*> group_queries;
+    for (size_t i : group)
+    {
+        group_queries.push_back(&plan.queries[i]);
+    }
+    FindAllDocumentsBatch(group_queries, status, slots);
+}
+
+void SearchServer::FindAllDocumentsBatch(const vector<const ResolvedQuery*>& queries, DocumentStatus status, BatchSlot* slots) const
+{
+    const auto accept = [this, status](int ordinal)
+    {
+        return IsLiveDocument(ordinal) && ordinal_to_document_[ordinal].status == status;
+    };
+
+    //Слова группы по возрастанию, как и слова каждого запроса, поэтому каждый запрос получает свои слагаемые
+    //в том же порядке, что и при отдельном подсчёте, и его релевантности совпадают с FindTopDocuments до бита
+    struct GroupTerm
+    {
+        int term = 0;
+        double inverse_document_freq = 0.0;
+        uint32_t lane_mask = 0;
+    };
+    map<string_view, GroupTerm> plus_terms;
+    for (size_t lane = 0; lane < queries.size(); ++lane)
+    {
+        for (const auto& [term, inverse_document_freq] : queries[lane]->plus_terms)
+        {
+            GroupTerm& group_term = plus_terms[terms_.GetTerm(term)];
+            group_term.term = term;
+            group_term.inverse_document_freq = inverse_document_freq;
+            group_term.lane_mask |= 1u << lane;
+        }
+    }
+
+    //Документы с минус-словами собираются до подсчёта, у каждого запроса свои, как в FindAllDocuments
+    StageTimer timer(SearchStage::MINUS_FILTERING);
+    const ThreadScratch<BatchExclusions>::Lease excluded = ThreadScratch<BatchExclusions>::Acquire();
+    uint32_t minus_lane_mask = 0;
+    for (size_t lane = 0; lane < queries.size(); ++lane)
+    {
+        if (queries[lane]->minus_terms.empty())
+        {
+            continue;
+        }
+        minus_lane_mask |= 1u << lane;
+        (*excluded)[lane].Reset(0, static_cast<int>(ordinal_to_document_.size()));
+        for (const int term : queries[lane]->minus_terms)
+        {
+            posting_index_.CollectOrdinals(term, (*excluded)[lane]);
+        }
+    }
+
+    timer.Next(SearchStage::SCORING);
+    const ThreadScratch<BatchScoreAccumulator>::Lease accumulator_lease = ThreadScratch<BatchScoreAccumulator>::Acquire();
+    BatchScoreAccumulator& accumulator = *accumulator_lease;
+    accumulator.Reset(ordinal_to_document_.size());
+    for (const auto& [word, group_term] : plus_terms)
+    {
+        posting_index_.ForEachPosting(group_term.term,
+            [&, &group_term = group_term](const Posting& posting)
+            {
+                uint32_t lane_mask = group_term.lane_mask;
+                if (lane_mask & minus_lane_mask)
+                {
+                    for (size_t lane = 0; lane < queries.size(); ++lane)
+                    {
+                        if ((minus_lane_mask & (1u << lane)) && (*excluded)[lane].Contains(posting.ordinal))
+                        {
+                            lane_mask &= ~(1u << lane);
+                        }
+                    }
+                }
+                if (lane_mask != 0)
+                {
+                    accumulator.Add(lane_mask, posting.ordinal, posting.term_freq * group_term.inverse_document_freq, accept);
+                }
+            });
+    }
+
+    timer.Next(SearchStage::TOP_K);
+    TopDocuments top_documents(MAX_RESULT_DOCUMENT_COUNT);
+    for (size_t lane = 0; lane < queries.size(); ++lane)
+    {
+        top_documents.Reset(MAX_RESULT_DOCUMENT_COUNT);
+        accumulator.ForEachDocument(lane,
+            [this, &top_documents](int ordinal, double relevance)
+            {
+                const DocumentAttributes& document = ordinal_to_document_[ordinal];
+                top_documents.Push(Document{ document.id, relevance, document.rating });
+            });
+        slots[lane].size = top_documents.ExtractTo(slots[lane].documents);
+    }
+}
+
 //Возвращает длину documents_
 int SearchServer::GetDocumentCount() const
 {
@@ -117,33 +567,36 @@ int SearchServer::GetDocumentCount() const
 
 tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(string_view raw_query, int document_id) const
 {
-    Query query = ParseQuery(raw_query);
+    const ThreadScratch<QueryScratch>::Lease scratch = ThreadScratch<QueryScratch>::Acquire();
+    Query& query = scratch->query;
+    ParseQuery(raw_query, query);
+    const int ordinal = documents_.at(document_id).ordinal;
 
     vector<string_view> matched_words;
 
     for (string_view word : query.minus_words)
     {
-        if (word_to_document_freqs_.count(word) == 0)
+        const int term = FindIndexedTerm(word);
+        if (term == TermDictionary::NO_TERM)
         {
             continue;
         }
-        if (word_to_document_freqs_.at(word).count(document_id))
+        if (forward_index_.Contains(ordinal, term))
         {
-            matched_words.clear();
-            //break;
-            return { {}, documents_.at(document_id).status };
+            return { vector<string_view>{}, documents_.at(document_id).status };
         }
     }
 
     for (string_view word : query.plus_words)
     {
-        if (word_to_document_freqs_.count(word) == 0)
+        const int term = FindIndexedTerm(word);
+        if (term == TermDictionary::NO_TERM)
         {
             continue;
         }
-        if (word_to_document_freqs_.at(word).count(document_id) && (find(matched_words.begin(), matched_words.end(), word) == matched_words.end()))
+        if (forward_index_.Contains(ordinal, term) && (find(matched_words.begin(), matched_words.end(), word) == matched_words.end()))
         {
-            matched_words.push_back(word);
+            matched_words.push_back(terms_.GetTerm(term));
         }
     }
 
@@ -161,19 +614,26 @@ tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(std::exec
 
 tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(std::execution::parallel_policy policy, string_view raw_query, int document_id) const
 {
-    if (documents_ids_.count(document_id) == 0)
+    if (documents_.count(document_id) == 0)
     {
         throw invalid_argument("no document with such id");
     }
     Query query = ParseQuery(raw_query);
     DocumentStatus status = documents_.at(document_id).status;
+    const int ordinal = documents_.at(document_id).ordinal;
+
+    const auto has_word = [&](string_view word)
+    {
+        const int term = terms_.Find(word);
+        return term != TermDictionary::NO_TERM && forward_index_.Contains(ordinal, term);
+    };
 
     vector<string_view> matched_words(query.plus_words.size());
     for (auto word : query.minus_words)
     {
-        if (ids_to_word_to_freqs.at(document_id).count(word))
+        if (has_word(word))
         {
-            return { {}, documents_.at(document_id).status };
+            return { vector<string_view>{}, documents_.at(document_id).status };
         }
     }
 
@@ -181,10 +641,7 @@ tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(std::exec
         execution::par,
         query.plus_words.begin(), query.plus_words.end(),
         matched_words.begin(),
-        [&](string_view word)
-        {
-            return ids_to_word_to_freqs.at(document_id).count(word);
-        });
+        has_word);
 
     sort(matched_words.begin(), it_end);
     auto it_end1 = unique(matched_words.begin(), it_end);
@@ -193,77 +650,453 @@ tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(std::exec
 }
 
 
-std::set<int>::const_iterator SearchServer::begin() const
+ChunkedMap<int, SearchServer::DocumentData>::key_iterator SearchServer::begin() const
 {
-    return documents_ids_.begin();
+    return documents_.key_begin();
 }
 
-std::set<int>::const_iterator SearchServer::end() const
+ChunkedMap<int, SearchServer::DocumentData>::key_iterator SearchServer::end() const
 {
-    return documents_ids_.end();
+    return documents_.key_end();
 }
 
 const map<string_view, double>& SearchServer::GetWordFrequencies(int document_id) const
 {
-    if (find(this->begin(), this->end(), document_id) == this->end())
+    const auto document_it = documents_.find(document_id);
+    if (document_it == documents_.end())
     {
         static const map<string_view, double> empty{};
         return empty;
     }
-    return ids_to_word_to_freqs.at(document_id);
+
+    lock_guard guard(word_frequencies_.mutex);
+    const auto [it, inserted] = word_frequencies_.documents.try_emplace(document_id);
+    if (inserted)
+    {
+        forward_index_.ForEachTerm(document_it->second.ordinal,
+            [this, &word_freqs = it->second](int term, double term_freq)
+            {
+                word_freqs.emplace(terms_.GetTerm(term), term_freq);
+            });
+    }
+    return it->second;
 }
 
 void SearchServer::RemoveDocument(int document_id)
 {
-    for (auto& [word, TF] : ids_to_word_to_freqs.at(document_id))
+    MarkDocumentRemoved(document_id);
+    if (NeedsCompaction())
+    {
+        Compact(execution::seq);
+    }
+}
+
+void SearchServer::RemoveDocument(std::execution::parallel_policy policy, int document_id)
+{
+    if (documents_.count(document_id) == 0) {
+        return;
+    }
+
+    MarkDocumentRemoved(document_id);
+    if (NeedsCompaction())
+    {
+        Compact(policy);
+    }
+}
+
+void SearchServer::RemoveDocument(std::execution::sequenced_policy policy, int document_id)
+{
+    RemoveDocument(document_id);
+}
+
+void SearchServer::RemoveDocuments(const vector<int>& document_ids)
+{
+    RemoveDocuments(execution::seq, document_ids);
+}
+
+void SearchServer::RemoveDocuments(execution::sequenced_policy policy, const vector<int>& document_ids)
+{
+    for (const int document_id : document_ids)
     {
-        if (word_to_document_freqs_.at(word).size() > 1)
+        if (documents_.count(document_id) > 0)
         {
-            auto pos = word_to_document_freqs_.at(word).find(document_id);
-            word_to_document_freqs_.at(word).erase(pos);
+            MarkDocumentRemoved(document_id);
         }
-        else
+    }
+    if (NeedsCompaction())
+    {
+        Compact(policy);
+    }
+}
+
+void SearchServer::RemoveDocuments(execution::parallel_policy policy, const vector<int>& document_ids)
+{
+    for (const int document_id : document_ids)
+    {
+        if (documents_.count(document_id) > 0)
         {
-            word_to_document_freqs_.erase(word);
+            MarkDocumentRemoved(document_id);
         }
     }
+    if (NeedsCompaction())
+    {
+        Compact(policy);
+    }
+}
 
-    ids_to_word_to_freqs.erase(document_id);
-    documents_ids_.erase(find(documents_ids_.begin(), documents_ids_.end(), document_id));
-    documents_.erase(document_id);
-    ids_to_words_.erase(document_id);
+void SearchServer::SetDuplicatePolicy(DuplicatePolicy policy)
+{
+    if (policy != DuplicatePolicy::ALLOW && duplicate_policy_ == DuplicatePolicy::ALLOW)
+    {
+        vector<pair<uint64_t, int>> fingerprints;
+        for (const auto& [document_id, document] : documents_)
+        {
+            if (forward_index_.GetTermCount(document.ordinal) > 0)
+            {
+                fingerprints.emplace_back(document.fingerprint, document_id);
+            }
+        }
+        sort(fingerprints.begin(), fingerprints.end());
+        vector<pair<uint64_t, vector<int>>> items;
+        for (const auto& [fingerprint, document_id] : fingerprints)
+        {
+            if (items.empty() || items.back().first != fingerprint)
+            {
+                items.emplace_back(fingerprint, vector<int>());
+            }
+            items.back().second.push_back(document_id);
+        }
+        fingerprint_to_documents_ = ChunkedMap<uint64_t, vector<int>>(move(items));
+    }
+    else if (policy == DuplicatePolicy::ALLOW)
+    {
+        fingerprint_to_documents_ = ChunkedMap<uint64_t, vector<int>>();
+    }
+    duplicate_policy_ = policy;
 }
 
-void SearchServer::RemoveDocument(std::execution::parallel_policy policy, int document_id)
+vector<int> SearchServer::GetReportedDuplicates() const
 {
-    if (ids_to_word_to_freqs.count(document_id) == 0) {
-        return;
+    return vector<int>(reported_duplicates_.begin(), reported_duplicates_.end());
+}
+
+vector<int> SearchServer::FindDuplicates() const
+{
+    return FindDuplicates(execution::seq);
+}
+
+vector<int> SearchServer::FindDuplicates(execution::sequenced_policy policy) const
+{
+    return FindDuplicatesImpl(policy);
+}
+
+vector<int> SearchServer::FindDuplicates(execution::parallel_policy policy) const
+{
+    return FindDuplicatesImpl(policy);
+}
+
+template <typename ExecutionPolicy>
+vector<int> SearchServer::FindDuplicatesImpl(ExecutionPolicy policy) const
+{
+    //Документы с равными отпечатками оказываются рядом, внутри группы - по возрастанию id
+    vector<pair<uint64_t, int>> fingerprints;
+    fingerprints.reserve(documents_.size());
+    for (const auto& [document_id, document] : documents_)
+    {
+        if (forward_index_.GetTermCount(document.ordinal) > 0)
+        {
+            fingerprints.emplace_back(document.fingerprint, document_id);
+        }
     }
+    sort(policy, fingerprints.begin(), fingerprints.end());
 
-    /* { {word, TF}, {word, TF}, ... } */
-    std::vector< std::pair<std::string, double> > words_and_it_freqs((ids_to_word_to_freqs.at(document_id)).size());
-    copy(policy,
-        (ids_to_word_to_freqs.at(document_id)).begin(), (ids_to_word_to_freqs.at(document_id)).end(),
-        words_and_it_freqs.begin());
+    vector<size_t> group_begins;
+    for (size_t i = 0; i < fingerprints.size(); ++i)
+    {
+        if (i == 0 || fingerprints[i].first != fingerprints[i - 1].first)
+        {
+            group_begins.push_back(i);
+        }
+    }
 
-    std::for_each(
+    //Совпадение отпечатков проверяется сравнением наборов слов, группы проверяются параллельно
+    vector<char> is_duplicate(fingerprints.size(), 0);
+    for_each(
         policy,
-        words_and_it_freqs.begin(),
-        words_and_it_freqs.end(),
-        [&](const std::pair<std::string, double>& word_freq) {
-            word_to_document_freqs_[word_freq.first].erase(document_id);
+        group_begins.begin(), group_begins.end(),
+        [&](size_t group_begin)
+        {
+            size_t group_end = group_begin + 1;
+            while (group_end < fingerprints.size() && fingerprints[group_end].first == fingerprints[group_begin].first)
+            {
+                ++group_end;
+            }
+            for (size_t i = group_begin + 1; i < group_end; ++i)
+            {
+                for (size_t j = group_begin; j < i; ++j)
+                {
+                    if (!is_duplicate[j] && forward_index_.HaveSameTerms(documents_.at(fingerprints[i].second).ordinal, documents_.at(fingerprints[j].second).ordinal))
+                    {
+                        is_duplicate[i] = 1;
+                        break;
+                    }
+                }
+            }
+        });
+
+    vector<int> duplicates;
+    for (size_t i = 0; i < fingerprints.size(); ++i)
+    {
+        if (is_duplicate[i])
+        {
+            duplicates.push_back(fingerprints[i].second);
         }
-    );
+    }
+    sort(duplicates.begin(), duplicates.end());
+    return duplicates;
+}
 
-    ids_to_word_to_freqs.erase(document_id);
-    documents_ids_.erase(find(documents_ids_.begin(), documents_ids_.end(), document_id));
-    ids_to_words_.erase(document_id);
-    documents_.erase(document_id);
+uint64_t SearchServer::ComputeFingerprint(const WordFrequencies& word_freqs)
+{
+    uint64_t fingerprint = word_freqs.size();
+    for (const auto& [word, term_freq] : word_freqs)
+    {
+        uint64_t word_hash = hash<string_view>{}(word);
+        word_hash ^= word_hash >> 33;
+        word_hash *= 0xff51afd7ed558ccdull;
+        word_hash ^= word_hash >> 33;
+        word_hash *= 0xc4ceb9fe1a85ec53ull;
+        word_hash ^= word_hash >> 33;
+        fingerprint += word_hash;
+    }
+    return fingerprint;
 }
 
-void SearchServer::RemoveDocument(std::execution::sequenced_policy policy, int document_id)
+bool SearchServer::IsDuplicate(uint64_t fingerprint, const WordFrequencies& word_freqs) const
 {
-    RemoveDocument(document_id);
+    if (duplicate_policy_ == DuplicatePolicy::ALLOW || word_freqs.empty())
+    {
+        return false;
+    }
+    const auto it = fingerprint_to_documents_.find(fingerprint);
+    if (it == fingerprint_to_documents_.end())
+    {
+        return false;
+    }
+    return any_of(it->second.begin(), it->second.end(),
+        [&](int document_id)
+        {
+            const int ordinal = documents_.at(document_id).ordinal;
+            return forward_index_.GetTermCount(ordinal) == word_freqs.size()
+                && all_of(word_freqs.begin(), word_freqs.end(),
+                    [&](const auto& word_freq)
+                    {
+                        const int term = terms_.Find(word_freq.first);
+                        return term != TermDictionary::NO_TERM && forward_index_.Contains(ordinal, term);
+                    });
+        });
+}
+
+void SearchServer::Compact()
+{
+    Compact(execution::seq);
+}
+
+void SearchServer::Compact(execution::sequenced_policy policy)
+{
+    CompactImpl(policy);
+}
+
+void SearchServer::Compact(execution::parallel_policy policy)
+{
+    CompactImpl(policy);
+}
+
+void SearchServer::Save(const string& path) const
+{
+    //Снимок пишется сжатым: номера неудалённых документов идут подряд
+    vector<int> new_ordinals(ordinal_to_document_.size(), -1);
+    vector<SnapshotDocument> documents;
+    documents.reserve(documents_.size());
+    for (size_t ordinal = 0; ordinal < ordinal_to_document_.size(); ++ordinal)
+    {
+        if (IsLiveDocument(static_cast<int>(ordinal)))
+        {
+            const DocumentAttributes& document = ordinal_to_document_[ordinal];
+            new_ordinals[ordinal] = static_cast<int>(documents.size());
+            documents.push_back({ document.id, document.rating, static_cast<int32_t>(document.status), 0, documents_.at(document.id).fingerprint });
+        }
+    }
+
+    SnapshotWriter writer(path);
+    writer.WriteStrings(SnapshotSection::STOP_WORDS_TEXT, SnapshotSection::STOP_WORD_OFFSETS, stop_words_.GetWords());
+    terms_.Save(writer);
+    posting_index_.Save(writer, new_ordinals);
+    forward_index_.Save(writer, new_ordinals);
+    writer.WriteSection(SnapshotSection::DOCUMENTS, documents.data(), documents.size());
+    writer.Finish();
+}
+
+SearchServer SearchServer::Open(const string& path, bool prefetch)
+{
+    const SnapshotReader reader(path, prefetch);
+    SearchServer server;
+    for (string_view word : reader.GetStrings(SnapshotSection::STOP_WORDS_TEXT, SnapshotSection::STOP_WORD_OFFSETS))
+    {
+        server.stop_words_.Add(word);
+    }
+    const SharedArray<SnapshotDocument> documents = reader.GetSection<SnapshotDocument>(SnapshotSection::DOCUMENTS);
+    server.terms_ = TermDictionary(reader);
+    server.posting_index_ = PostingIndex(reader, documents.size());
+    server.forward_index_ = ForwardIndex(reader, server.terms_.GetTermCount());
+
+    //Блоки списков вхождений и слова документов проверены при загрузке, здесь разделы сверяются между собой
+    if (server.posting_index_.GetTermCount() != server.terms_.GetTermCount()
+        || server.forward_index_.GetDocumentCount() != documents.size())
+    {
+        throw invalid_argument("Invalid snapshot: sections don't match");
+    }
+    //Удаление документа уменьшает счётчики его слов по прямому индексу, так что у каждого слова в прямом индексе
+    //должно быть столько документов, сколько вхождений в его списке
+    vector<size_t> term_document_counts(server.terms_.GetTermCount(), 0);
+    for (size_t ordinal = 0; ordinal < documents.size(); ++ordinal)
+    {
+        server.forward_index_.ForEachTerm(static_cast<int>(ordinal),
+            [&term_document_counts](int term, double)
+            {
+                ++term_document_counts[term];
+            });
+    }
+    for (size_t term = 0; term < term_document_counts.size(); ++term)
+    {
+        if (term_document_counts[term] != server.posting_index_.GetPostingCount(term))
+        {
+            throw invalid_argument("Invalid snapshot: document words don't match posting lists");
+        }
+    }
+
+    vector<pair<int, DocumentData>> documents_by_id;
+    documents_by_id.reserve(documents.size());
+    for (size_t ordinal = 0; ordinal < documents.size(); ++ordinal)
+    {
+        const SnapshotDocument& document = documents[ordinal];
+        if (document.status < 0 || document.status > static_cast<int32_t>(DocumentStatus::REMOVED))
+        {
+            throw invalid_argument("Invalid snapshot: bad document status");
+        }
+        if (document.id < 0)
+        {
+            throw invalid_argument("Invalid snapshot: negative document id");
+        }
+        const DocumentStatus status = static_cast<DocumentStatus>(document.status);
+        documents_by_id.emplace_back(document.id, DocumentData{ document.rating, status, static_cast<int>(ordinal), document.fingerprint });
+        server.ordinal_to_document_.push_back({ document.id, document.rating, status });
+    }
+    sort(documents_by_id.begin(), documents_by_id.end(),
+        [](const auto& lhs, const auto& rhs)
+        {
+            return lhs.first < rhs.first;
+        });
+    if (adjacent_find(documents_by_id.begin(), documents_by_id.end(),
+        [](const auto& lhs, const auto& rhs)
+        {
+            return lhs.first == rhs.first;
+        }) != documents_by_id.end())
+    {
+        throw invalid_argument("Invalid snapshot: repeated document id");
+    }
+    server.documents_ = ChunkedMap<int, DocumentData>(move(documents_by_id));
+    server.live_documents_.assign((documents.size() + 63) / 64, 0);
+    for (size_t ordinal = 0; ordinal < documents.size(); ++ordinal)
+    {
+        server.live_documents_.GetMutable(ordinal / 64) |= uint64_t(1) << (ordinal % 64);
+    }
+
+    server.term_document_counts_.resize(server.terms_.GetTermCount());
+    server.term_log_document_freqs_.resize(server.terms_.GetTermCount());
+    for (size_t term = 0; term < server.terms_.GetTermCount(); ++term)
+    {
+        server.term_document_counts_.GetMutable(term) = static_cast<int>(server.posting_index_.GetPostingCount(term));
+        server.UpdateTermDocumentFreq(static_cast<int>(term));
+    }
+    server.UpdateDocumentCount();
+    return server;
+}
+
+void SearchServer::MarkDocumentRemoved(int document_id)
+{
+    const DocumentData& document = documents_.at(document_id);
+    const int ordinal = document.ordinal;
+    if (duplicate_policy_ != DuplicatePolicy::ALLOW)
+    {
+        vector<int>* document_ids = fingerprint_to_documents_.FindMutable(document.fingerprint);
+        if (document_ids != nullptr)
+        {
+            document_ids->erase(remove(document_ids->begin(), document_ids->end(), document_id), document_ids->end());
+            if (document_ids->empty())
+            {
+                fingerprint_to_documents_.Erase(document.fingerprint);
+            }
+        }
+    }
+    live_documents_.GetMutable(ordinal / 64) &= ~(uint64_t(1) << (ordinal % 64));
+
+    forward_index_.ForEachTerm(ordinal,
+        [this](int term, double term_freq)
+        {
+            --term_document_counts_.GetMutable(term);
+            UpdateTermDocumentFreq(term);
+        });
+    removed_posting_count_ += forward_index_.GetTermCount(ordinal);
+    forward_index_.Remove(ordinal);
+
+    {
+        lock_guard guard(word_frequencies_.mutex);
+        word_frequencies_.documents.erase(document_id);
+    }
+    documents_.Erase(document_id);
+    UpdateDocumentCount();
+}
+
+bool SearchServer::NeedsCompaction() const
+{
+    return removed_posting_count_ * 4 > posting_index_.GetTotalPostingCount();
+}
+
+template <typename ExecutionPolicy>
+void SearchServer::CompactImpl(ExecutionPolicy policy)
+{
+    //Новые номера идут подряд в прежнем порядке, поэтому списки вхождений остаются отсортированными
+    vector<int> new_ordinals(ordinal_to_document_.size(), -1);
+    vector<DocumentAttributes> live_documents;
+    live_documents.reserve(documents_.size());
+    for (size_t ordinal = 0; ordinal < ordinal_to_document_.size(); ++ordinal)
+    {
+        if (IsLiveDocument(static_cast<int>(ordinal)))
+        {
+            new_ordinals[ordinal] = static_cast<int>(live_documents.size());
+            live_documents.push_back(ordinal_to_document_[ordinal]);
+        }
+    }
+
+    posting_index_.Compact(policy, new_ordinals);
+    forward_index_.Compact(policy, new_ordinals);
+    vector<pair<int, DocumentData>> documents;
+    documents.reserve(documents_.size());
+    for (const auto& [document_id, document] : documents_)
+    {
+        documents.emplace_back(document_id, document);
+        documents.back().second.ordinal = new_ordinals[document.ordinal];
+    }
+    documents_ = ChunkedMap<int, DocumentData>(move(documents));
+    ordinal_to_document_ = ChunkedArray<DocumentAttributes>(live_documents);
+
+    live_documents_.assign((ordinal_to_document_.size() + 63) / 64, 0);
+    for (size_t ordinal = 0; ordinal < ordinal_to_document_.size(); ++ordinal)
+    {
+        live_documents_.GetMutable(ordinal / 64) |= uint64_t(1) << (ordinal % 64);
+    }
+    removed_posting_count_ = 0;
 }
 
 bool SearchServer::IsValidString(string_view text)
@@ -278,18 +1111,15 @@ bool SearchServer::IsValidString(string_view text)
 
 bool SearchServer::IsStopWord(string_view word) const
 {
-    return stop_words_.count(string(word)) > 0;
+    return stop_words_.Contains(word);
 }
 
 vector<string_view> SearchServer::SplitIntoWordsNoStop(string_view text) const
 {
     vector<string_view> words;
-    for (string_view word : SplitIntoWordsView(text))
+    if (!SplitIntoWordsChecked(text, stop_words_, words))
     {
-        if (!IsStopWord(word))
-        {
-            words.push_back(word);
-        }
+        throw invalid_argument("Forbidden symbols");
     }
     return words;
 }
@@ -336,45 +1166,150 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(string_view word) const
 
 SearchServer::Query SearchServer::ParseQuery(string_view text) const
 {
-    if (!IsValidString(text))
+    Query query;
+    ParseQuery(text, query);
+    return query;
+}
+
+void SearchServer::ParseQuery(string_view text, Query& query) const
+{
+    //Слова дробятся сразу в plus_words, минус-слова затем переносятся из него с сохранением порядка
+    query.plus_words.clear();
+    query.minus_words.clear();
+    if (!SplitIntoWordsChecked(text, stop_words_, query.plus_words))
     {
         throw invalid_argument("Forbidden symbols");
     }
-
-    Query query;
-    vector<string_view> split_words = SplitIntoWordsView(text);
-    for (string_view word : split_words)
+    size_t plus_word_count = 0;
+    for (string_view word : query.plus_words)
     {
-        if (!IsStopWord(word))
+        if (word[0] == '-')
         {
+            word = word.substr(1);
+            if (word.empty())
+            {
+                throw invalid_argument("No text after minus");
+            }
             if (word[0] == '-')
             {
-                word = word.substr(1);
-                if (word.empty())
-                {
-                    throw invalid_argument("No text after minus");
-                }
-                if (word[0] == '-')
-                {
-                    throw invalid_argument("Multiple minuses");
-                }
-                query.minus_words.push_back(word);
-                continue;
+                throw invalid_argument("Multiple minuses");
             }
-            query.plus_words.push_back(word);
+            query.minus_words.push_back(word);
+            continue;
         }
+        query.plus_words[plus_word_count++] = word;
     }
+    query.plus_words.resize(plus_word_count);
+}
 
-    //sort(query.plus_words.begin(), query.plus_words.end());
-    //auto plus_words_end = unique(query.plus_words.begin(), query.plus_words.end());
-    //query.plus_words.resize(distance(query.plus_words.begin(), plus_words_end));
+SearchServer::Query SearchServer::ParseNormalizedQuery(string_view text) const
+{
+    Query query = ParseQuery(text);
+    for (vector<string_view>* words : { &query.plus_words, &query.minus_words })
+    {
+        sort(words->begin(), words->end());
+        words->erase(unique(words->begin(), words->end()), words->end());
+    }
     return query;
 }
 
+void SearchServer::AppendQueryKey(const Query& query, string& key)
+{
+    //Управляющих символов в словах нет, ими и разделяются слова
+    for (string_view word : query.plus_words)
+    {
+        key.append(word).push_back('\0');
+    }
+    key.push_back('\1');
+    for (string_view word : query.minus_words)
+    {
+        key.append(word).push_back('\0');
+    }
+}
+
+size_t SearchServer::GetScoringPartCount()
+{
+    return max(1u, thread::hardware_concurrency());
+}
+
+bool SearchServer::UseBlockMaxScoring(const ResolvedQuery& query, size_t top_k, size_t part_count) const
+{
+    //Обход документ за документом дороже полного подсчёта на вхождение в несколько раз и окупается
+    //только на длинных списках, где большую часть вхождений удаётся пропустить
+    const size_t MIN_POSTING_COUNT_PER_PART = 1 << 15;
+    const size_t MIN_POSTING_COUNT_PER_RESULT = 1 << 10;
+    size_t posting_count = 0;
+    for (const auto& [term, inverse_document_freq] : query.plus_terms)
+    {
+        //Оценки сверху по наибольшей TF верны только для неотрицательных IDF
+        if (inverse_document_freq < 0.0)
+        {
+            return false;
+        }
+        posting_count += posting_index_.GetPostingCount(term);
+    }
+    return top_k > 0 && posting_count >= part_count * max(MIN_POSTING_COUNT_PER_PART, top_k * MIN_POSTING_COUNT_PER_RESULT);
+}
+
+int SearchServer::FindIndexedTerm(string_view word) const
+{
+    const int term = terms_.Find(word);
+    if (term == TermDictionary::NO_TERM || term_document_counts_[term] == 0)
+    {
+        return TermDictionary::NO_TERM;
+    }
+    return term;
+}
+
+int SearchServer::GetWordDocumentCount(string_view word) const
+{
+    const int term = FindIndexedTerm(word);
+    return term == TermDictionary::NO_TERM ? 0 : term_document_counts_[term];
+}
+
+void SearchServer::UpdateTermDocumentFreq(int term)
+{
+    term_log_document_freqs_.GetMutable(term) = log(static_cast<double>(term_document_counts_[term]));
+}
+
+void SearchServer::UpdateDocumentCount()
+{
+    log_document_count_ = log(static_cast<double>(GetDocumentCount()));
+    generation_ = NextGeneration();
+}
+
+uint64_t SearchServer::NextGeneration()
+{
+    static atomic<uint64_t> last_generation{ 0 };
+    return ++last_generation;
+}
+
+uint64_t SearchServer::GetGeneration() const
+{
+    return generation_;
+}
+
+SearchServer::ResolvedQuery SearchServer::ResolveQuery(const Query& query) const
+{
+    ResolvedQuery resolved;
+    ResolveQuery(query, resolved);
+    return resolved;
+}
+
+void SearchServer::ResolveQuery(const Query& query, ResolvedQuery& resolved) const
+{
+    ResolveQuery(query,
+        [this](string_view word, int term)
+        {
+            return ComputeWordInverseDocumentFreq(term);
+        },
+        resolved);
+}
+
 // Existence required
-double SearchServer::ComputeWordInverseDocumentFreq(const string& word) const
+double SearchServer::ComputeWordInverseDocumentFreq(int term) const
 {
-    return log(SearchServer::GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
+    return log_document_count_ - term_log_document_freqs_[term];
 }
 
 ostream& operator<<(ostream& out, const Document doc)
@@ -1,19 +1,37 @@
 #pragma once
 #include "document.h"
 #include "log_duration.h"
-#include "concurrent_map.h"
+#include "stage_profiler.h"
+#include "posting_index.h"
+#include "forward_index.h"
+#include "term_dictionary.h"
+#include "top_documents.h"
+#include "score_accumulator.h"
+#include "block_max_scorer.h"
+#include "ordinal_set.h"
+#include "string_processing.h"
+#include "snapshot.h"
+#include "batch_results.h"
+#include "thread_scratch.h"
+#include "chunked_array.h"
+#include "chunked_map.h"
 #include<vector>
 #include<string>
 #include<string_view>
 #include<iostream>
 #include<set>
 #include<map>
+#include <unordered_map>
 #include <algorithm>
 #include <numeric>
 #include <execution>
+#include <thread>
+#include <optional>
+#include <array>
+#include <cstdint>
+#include <mutex>
 
-const double EPSILON = 1e-6; //Число для сравнения double чисел
-const int MAX_RESULT_DOCUMENT_COUNT = 5;
+const int MAX_RESULT_DOCUMENT_COUNT = 5; //Размер выдачи по умолчанию
 
 enum class DocumentStatus
 {
@@ -25,8 +43,37 @@ enum class DocumentStatus
 
 
 
+//Что делать при добавлении документа с тем же набором слов, что у уже добавленного
+enum class DuplicatePolicy
+{
+    ALLOW,      //Не проверять
+    REJECT,     //Не добавлять: AddDocument бросает invalid_argument, AddDocuments возвращает ошибку
+    REPORT      //Добавить и запомнить id, см. GetReportedDuplicates
+};
+
+//Документ для пакетного добавления
+struct NewDocument
+{
+    int id = 0;
+    std::string_view text;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+};
+
+//Причина, по которой документ пакета не был добавлен
+struct AddDocumentError
+{
+    size_t index = 0;                                                       //Номер документа в пакете
+    int document_id = 0;
+    std::string message;
+};
+
 class SearchServer
 {
+    friend class SegmentedSearchServer;
+    friend class QueryResultCache;
+    struct DocumentData;
+
 public:
 
     SearchServer() = default;
@@ -41,21 +88,19 @@ public:
     {
         for (std::string_view str : container)
         {
-            if (!str.empty())
+            if (!IsValidString(str))
             {
-                stop_words_.emplace(str);
+                throw std::invalid_argument("Forbidden symbols");
             }
         }
 
-        std::for_each(
-            stop_words_.begin(), stop_words_.end(),
-            [&](const auto& word)
+        for (std::string_view str : container)
+        {
+            if (!str.empty())
             {
-                if (!IsValidString(word))
-                {
-                    throw std::invalid_argument("Forbidden symbols");
-                }
-            });
+                stop_words_.Add(str);
+            }
+        }
     }
 
     void SetStopWords(const std::string& text);
@@ -63,6 +108,26 @@ public:
     //Добавляет в documents_ id, средний рейтинг, статус
     void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
 
+    //Добавляет пачку документов: тексты разбираются параллельно, списки вхождений пополняются за один проход.
+    //Документы с занятым id или запрещёнными символами не добавляются и возвращаются в списке ошибок
+    std::vector<AddDocumentError> AddDocuments(const std::vector<NewDocument>& documents);
+    std::vector<AddDocumentError> AddDocuments(std::execution::sequenced_policy policy, const std::vector<NewDocument>& documents);
+    std::vector<AddDocumentError> AddDocuments(std::execution::parallel_policy policy, const std::vector<NewDocument>& documents);
+
+    //Возвращают top_k самых релевантных документов
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate predicate, size_t top_k) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus check_status, size_t top_k) const;
+
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(std::execution::sequenced_policy policy, std::string_view raw_query, DocumentPredicate predicate, size_t top_k) const;
+    std::vector<Document> FindTopDocuments(std::execution::sequenced_policy policy, std::string_view raw_query, DocumentStatus check_status, size_t top_k) const;
+
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(std::execution::parallel_policy policy, std::string_view raw_query, DocumentPredicate predicate, size_t top_k) const;
+    std::vector<Document> FindTopDocuments(std::execution::parallel_policy policy, std::string_view raw_query, DocumentStatus check_status, size_t top_k) const;
+
+    //Возвращают MAX_RESULT_DOCUMENT_COUNT самых релевантных документов
     template <typename DocumentPredicate>
     std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate predicate) const;
     std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus check_status) const;
@@ -78,25 +143,110 @@ public:
     std::vector<Document> FindTopDocuments(std::execution::parallel_policy policy, std::string_view raw_query, DocumentStatus check_status) const;
     std::vector<Document> FindTopDocuments(std::execution::parallel_policy policy, std::string_view raw_query) const;
 
+    //Выполняет пачку запросов: для каждого - то же, что FindTopDocuments(raw_query, status). Работа делится между запросами:
+    //одинаковые запросы выполняются один раз, каждое слово ищется в словаре один раз, а запросы, у которых совпадает
+    //самое длинное из слов, считаются вместе за один проход по спискам вхождений своих слов.
+    //Выдачи всех запросов складываются в один буфер
+    BatchResults FindTopDocumentsBatch(const std::vector<std::string>& raw_queries, DocumentStatus status = DocumentStatus::ACTUAL) const;
+    BatchResults FindTopDocumentsBatch(std::execution::sequenced_policy policy, const std::vector<std::string>& raw_queries, DocumentStatus status = DocumentStatus::ACTUAL) const;
+    BatchResults FindTopDocumentsBatch(std::execution::parallel_policy policy, const std::vector<std::string>& raw_queries, DocumentStatus status = DocumentStatus::ACTUAL) const;
+
+    //То же, но выдачи не складываются, а передаются visitor(номер запроса, BatchResults::Range), как только посчитана
+    //группа запроса, поэтому не по порядку запросов. Вызовы visitor не пересекаются и при параллельном выполнении.
+    //Выдача одинаковых запросов не копируется, диапазон валиден только во время вызова visitor
+    template <typename ExecutionPolicy, typename Visitor>
+    void VisitTopDocumentsBatch(ExecutionPolicy policy, const std::vector<std::string>& raw_queries, Visitor visitor, DocumentStatus status = DocumentStatus::ACTUAL) const
+    {
+        const BatchPlan plan = PlanTopDocumentsBatch(policy, raw_queries);
+
+        //Запросы без найденных плюс-слов не входят в группы и ничего не находят
+        const std::vector<Document> no_documents;
+        for (size_t i = 0; i < plan.queries.size(); ++i)
+        {
+            if (plan.queries[i].plus_terms.empty())
+            {
+                for (size_t query_index : plan.query_indexes[i])
+                {
+                    visitor(query_index, BatchResults::Range(no_documents.begin(), no_documents.end()));
+                }
+            }
+        }
+
+        std::mutex visitor_mutex;
+        std::for_each(policy, plan.groups.begin(), plan.groups.end(),
+            [&](const std::vector<size_t>& group)
+            {
+                std::vector<Document> documents(group.size() * MAX_RESULT_DOCUMENT_COUNT);
+                std::array<BatchSlot, BatchScoreAccumulator::LANE_COUNT> slots;
+                for (size_t lane = 0; lane < group.size(); ++lane)
+                {
+                    slots[lane].documents = documents.data() + lane * MAX_RESULT_DOCUMENT_COUNT;
+                }
+                FindTopDocumentsGroup(plan, group, status, slots.data());
+
+                std::lock_guard guard(visitor_mutex);
+                for (size_t lane = 0; lane < group.size(); ++lane)
+                {
+                    const auto begin = documents.cbegin() + lane * MAX_RESULT_DOCUMENT_COUNT;
+                    for (size_t query_index : plan.query_indexes[group[lane]])
+                    {
+                        visitor(query_index, BatchResults::Range(begin, begin + slots[lane].size));
+                    }
+                }
+            });
+    }
+
     //Возвращает длину documents_
     int GetDocumentCount() const;
 
+    //Номер состояния индекса. Меняется при каждом изменении документов и стоп-слов и не повторяется ни у какого
+    //другого индекса процесса, поэтому индексы с равными номерами (копии одного состояния) дают одинаковую выдачу
+    uint64_t GetGeneration() const;
+
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query, int document_id) const;
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::execution::parallel_policy, std::string_view raw_query, int document_id) const;
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::execution::sequenced_policy, std::string_view raw_query, int document_id) const;
 
-    std::set<int>::const_iterator begin() const;
+    ChunkedMap<int, DocumentData>::key_iterator begin() const;
 
-    std::set<int>::const_iterator end() const;
+    ChunkedMap<int, DocumentData>::key_iterator end() const;
 
+    //Частоты слов документа. Словарь собирается из прямого индекса при первом запросе и живёт до удаления документа
     const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
 
     void RemoveDocument(int document_id);
     void RemoveDocument(std::execution::parallel_policy, int document_id);
     void RemoveDocument(std::execution::sequenced_policy, int document_id);
 
-    std::map<int, std::set<std::string>> ids_to_words_;                     // Словарь id - все слова без повторов в документе
+    //Удаляет пачку документов, отсутствующие id пропускаются. Удалённые документы сразу исключаются из поиска,
+    //а их вхождения вычищаются сжатием индекса, когда их накапливается больше четверти всех вхождений
+    void RemoveDocuments(const std::vector<int>& document_ids);
+    void RemoveDocuments(std::execution::sequenced_policy policy, const std::vector<int>& document_ids);
+    void RemoveDocuments(std::execution::parallel_policy policy, const std::vector<int>& document_ids);
+
+    //Включает проверку дубликатов при добавлении документов
+    void SetDuplicatePolicy(DuplicatePolicy policy);
+
+    //id документов, добавленных при DuplicatePolicy::REPORT, у которых нашёлся дубликат
+    std::vector<int> GetReportedDuplicates() const;
 
+    //id документов, набор слов которых совпадает с набором слов документа с меньшим id, по возрастанию
+    std::vector<int> FindDuplicates() const;
+    std::vector<int> FindDuplicates(std::execution::sequenced_policy policy) const;
+    std::vector<int> FindDuplicates(std::execution::parallel_policy policy) const;
+
+    //Сжатие индекса: вычищает вхождения удалённых документов и перенумеровывает оставшиеся документы подряд
+    void Compact();
+    void Compact(std::execution::sequenced_policy policy);
+    void Compact(std::execution::parallel_policy policy);
+
+    //Сохраняет индекс в снимок path: стоп-слова, словарь, списки вхождений, прямой индекс и документы.
+    //Удалённые документы в снимок не попадают, настройка дубликатов не сохраняется
+    void Save(const std::string& path) const;
+
+    //Открывает снимок, сохранённый Save. Словарь, списки вхождений и прямой индекс читаются прямо из
+    //отображённого файла и копируются в память, только когда индекс меняется. prefetch заранее подгружает весь файл
+    static SearchServer Open(const std::string& path, bool prefetch = false);
 
 private:
     //Структура рейтинг, DocumentStatus(DocumentStatus::actuall,DocumentStatus::banned...)
@@ -104,24 +254,110 @@ private:
     {
         int rating = 0;
         DocumentStatus status = DocumentStatus::ACTUAL;
-        std::string raw_text;
+        int ordinal = 0;                                                    //Порядковый номер документа в индексе
+        uint64_t fingerprint = 0;                                           //Отпечаток набора различных слов
     };
 
-    std::set<std::string, std::less<>> stop_words_;                                      //Множество стоп-слов
-    std::map<std::string_view, std::map<int, double>> word_to_document_freqs_;   //Словарь: слово - словарь(id,частота встречи в документах(TF))
-    std::map<int, DocumentData> documents_;                                 //Словарь: id - DocumentData(рейтинг, статус)
-    std::set<int> documents_ids_;                                           // Идентификаторы
-    std::map<int, std::map<std::string_view, double>> ids_to_word_to_freqs;      // Словарь: id - слова - частота
+    //Документ в снимке, по порядку номеров
+    struct SnapshotDocument
+    {
+        int32_t id = 0;
+        int32_t rating = 0;
+        int32_t status = 0;
+        int32_t reserved = 0;
+        uint64_t fingerprint = 0;
+    };
+
+    //Данные документа, нужные при подсчёте релевантности
+    struct DocumentAttributes
+    {
+        int id = 0;
+        int rating = 0;
+        DocumentStatus status = DocumentStatus::ACTUAL;
+    };
+
+    WordSet stop_words_;                                                    //Множество стоп-слов
+    TermDictionary terms_;                                                  //Все слова документов, id слова - номер его списка вхождений
+    PostingIndex posting_index_;                                            //Списки вхождений (порядковый номер, TF) всех слов
+    ForwardIndex forward_index_;                                            //Порядковый номер - id слов документа и их TF
+    ChunkedMap<int, DocumentData> documents_;                               //Словарь: id - DocumentData(рейтинг, статус), по возрастанию id
+    ChunkedArray<DocumentAttributes> ordinal_to_document_;                  //Порядковый номер - id, рейтинг, статус
+    ChunkedArray<uint64_t> live_documents_;                                 //Битовая карта неудалённых документов по порядковому номеру
+    size_t removed_posting_count_ = 0;                                      //Вхождения удалённых документов, ждущие сжатия
+    DuplicatePolicy duplicate_policy_ = DuplicatePolicy::ALLOW;
+    ChunkedMap<uint64_t, std::vector<int>> fingerprint_to_documents_;       //Отпечаток - id документов с ним, ведётся только при проверке дубликатов
+    ChunkedArray<int> reported_duplicates_;
+    ChunkedArray<int> term_document_counts_;                                //id слова - число неудалённых документов с этим словом
+    ChunkedArray<double> term_log_document_freqs_;                          //id слова - логарифм числа документов с этим словом
+    double log_document_count_ = 0.0;                                       //Логарифм числа документов
+    uint64_t generation_ = NextGeneration();                                //См. GetGeneration
+    //Словари частот, уже запрошенные через GetWordFrequencies. Копия сервера начинает с пустого кэша
+    struct WordFrequenciesCache
+    {
+        std::mutex mutex;
+        std::map<int, std::map<std::string_view, double>> documents;
+
+        WordFrequenciesCache() = default;
+        WordFrequenciesCache(const WordFrequenciesCache&)
+        {
+        }
+        WordFrequenciesCache& operator=(const WordFrequenciesCache&)
+        {
+            documents.clear();
+            return *this;
+        }
+    };
+    mutable WordFrequenciesCache word_frequencies_;
 
     static bool IsValidString(std::string_view text);
 
     bool IsStopWord(std::string_view word) const;
 
-    //Из строки в вектор слов, исключая стоп-слова
+    //Из строки в вектор слов, исключая стоп-слова. Бросает invalid_argument, если в строке есть управляющие символы
     std::vector<std::string_view> SplitIntoWordsNoStop(std::string_view text) const;
 
     static int ComputeAverageRating(const std::vector<int>& ratings);
 
+    //Частоты слов документа (TF) по возрастанию слов
+    using WordFrequencies = std::vector<std::pair<std::string_view, double>>;
+    static WordFrequencies ComputeWordFrequencies(std::vector<std::string_view> words);
+
+    //Заносит документ в documents_ и прямой индекс, выдаёт id его словам и дописывает его вхождения в postings
+    void RegisterDocument(int document_id, DocumentStatus status, int rating,
+        const WordFrequencies& word_freqs, uint64_t fingerprint, std::vector<std::pair<size_t, Posting>>& postings);
+
+    //Сливает накопленные RegisterDocument вхождения в индекс и обновляет IDF
+    void IndexPostings(const std::vector<std::pair<size_t, Posting>>& postings);
+
+    //Добавляет все неудалённые документы другого индекса с их частотами, рейтингом и статусом.
+    //Бросает invalid_argument, если какой-то id уже занят
+    void AddDocumentsFrom(const SearchServer& other);
+
+    //Отпечаток набора различных слов: сумма перемешанных хешей слов, от порядка слов не зависит
+    static uint64_t ComputeFingerprint(const WordFrequencies& word_freqs);
+
+    //Есть ли уже документ с тем же набором слов. Всегда false, если проверка дубликатов выключена
+    bool IsDuplicate(uint64_t fingerprint, const WordFrequencies& word_freqs) const;
+
+    template <typename ExecutionPolicy>
+    std::vector<int> FindDuplicatesImpl(ExecutionPolicy policy) const;
+
+    template <typename ExecutionPolicy>
+    std::vector<AddDocumentError> AddDocumentsBatch(ExecutionPolicy policy, const std::vector<NewDocument>& documents);
+
+    bool IsLiveDocument(int ordinal) const
+    {
+        return (live_documents_[ordinal / 64] >> (ordinal % 64)) & 1;
+    }
+
+    //Помечает документ удалённым и убирает его из всего, кроме списков вхождений
+    void MarkDocumentRemoved(int document_id);
+
+    bool NeedsCompaction() const;
+
+    template <typename ExecutionPolicy>
+    void CompactImpl(ExecutionPolicy policy);
+
     //Структура слово - bool(минус-слово) - bool(плюс-слово)
     struct QueryWord
     {
@@ -141,201 +377,329 @@ private:
 
     //Делает из строки множества плюс и минус слов
     Query ParseQuery(std::string_view text) const;
+    //То же в query, переиспользуя её память
+    void ParseQuery(std::string_view text, Query& query) const;
+
+    //То же, но плюс- и минус-слова по возрастанию без повторов, так запросы, отличающиеся порядком слов, совпадают
+    Query ParseNormalizedQuery(std::string_view text) const;
+
+    //Дописывает к key строку, по которой нормализованные запросы можно сравнивать
+    static void AppendQueryKey(const Query& query, std::string& key);
+
+    //id слова или TermDictionary::NO_TERM, если слово не встречается ни в одном документе
+    int FindIndexedTerm(std::string_view word) const;
+
+    //Число неудалённых документов, в которых встречается слово
+    int GetWordDocumentCount(std::string_view word) const;
+
+    //Пересчитывает сохранённые логарифмы после изменения списка вхождений слова или числа документов
+    void UpdateTermDocumentFreq(int term);
+    //Вызывается при каждом изменении набора документов, заодно выдаёт индексу новый номер состояния
+    void UpdateDocumentCount();
+
+    static uint64_t NextGeneration();
 
     // Existence required
-    double ComputeWordInverseDocumentFreq(const std::string& word) const;
+    double ComputeWordInverseDocumentFreq(int term) const;
 
-    template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(std::execution::sequenced_policy policy, const Query& query, DocumentPredicate predicate) const
+    //Число частей, на которые делится диапазон порядковых номеров при параллельном подсчёте
+    static size_t GetScoringPartCount();
+
+    //Запрос с найденными id слов: плюс-слова вместе с их IDF и минус-слова. Слова, которых нет в индексе, отброшены
+    struct ResolvedQuery
+    {
+        std::vector<std::pair<int, double>> plus_terms;
+        std::vector<int> minus_terms;
+    };
+
+    //IDF плюс-слова даёт inverse_document_freq(слово, id слова). Так несколько индексов одного корпуса
+    //могут считать релевантность по общей статистике
+    template <typename InverseDocumentFreq>
+    ResolvedQuery ResolveQuery(const Query& query, InverseDocumentFreq inverse_document_freq) const
     {
-        std::map<int, double> document_to_relevance;
+        ResolvedQuery resolved;
+        ResolveQuery(query, inverse_document_freq, resolved);
+        return resolved;
+    }
+
+    //То же в resolved, переиспользуя её память
+    template <typename InverseDocumentFreq>
+    void ResolveQuery(const Query& query, InverseDocumentFreq inverse_document_freq, ResolvedQuery& resolved) const
+    {
+        resolved.plus_terms.clear();
+        resolved.minus_terms.clear();
         for (std::string_view word : query.plus_words)
         {
-            if (word_to_document_freqs_.count(word) == 0)
+            const int term = FindIndexedTerm(word);
+            if (term != TermDictionary::NO_TERM)
             {
-                continue;
-            }
-            const double inverse_document_freq = ComputeWordInverseDocumentFreq(std::string(word));
-            for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word))
-            {
-                auto current_document = documents_.at(document_id);
-                if (predicate(document_id, current_document.status, current_document.rating))
-                {
-                    document_to_relevance[document_id] += term_freq * inverse_document_freq;
-                }
+                resolved.plus_terms.emplace_back(term, inverse_document_freq(word, term));
             }
         }
-
         for (std::string_view word : query.minus_words)
         {
-            if (word_to_document_freqs_.count(word) == 0)
+            const int term = FindIndexedTerm(word);
+            if (term != TermDictionary::NO_TERM)
             {
-                continue;
+                resolved.minus_terms.push_back(term);
             }
-            for (const auto [document_id, _] : word_to_document_freqs_.at(word))
+        }
+    }
+
+    ResolvedQuery ResolveQuery(const Query& query) const;
+    void ResolveQuery(const Query& query, ResolvedQuery& resolved) const;
+
+    //Разобранный запрос, см. ThreadScratch
+    struct QueryScratch
+    {
+        Query query;
+        ResolvedQuery resolved;
+    };
+
+    //Отборы частей параллельного подсчёта, см. ThreadScratch
+    struct ScoringScratch
+    {
+        std::vector<TopDocuments> part_top_documents;
+        std::vector<size_t> parts;
+    };
+
+    //Документы с минус-словами каждого запроса пачки, см. FindAllDocumentsBatch
+    using BatchExclusions = std::array<OrdinalSet, BatchScoreAccumulator::LANE_COUNT>;
+
+    //Разобранная пачка запросов: различные запросы со словами, найденными в словаре, и группы из них, которые считаются вместе
+    struct BatchPlan
+    {
+        std::vector<ResolvedQuery> queries;
+        std::vector<std::vector<size_t>> query_indexes;     //Номера в пачке, под которыми встречается каждый различный запрос, по возрастанию
+        std::vector<size_t> query_to_distinct;              //Различный запрос для каждого запроса пачки
+        std::vector<std::vector<size_t>> groups;            //Запросы без плюс-слов не входят ни в одну группу
+    };
+
+    //Место под выдачу одного запроса группы: MAX_RESULT_DOCUMENT_COUNT документов и число занятых
+    struct BatchSlot
+    {
+        Document* documents = nullptr;
+        size_t size = 0;
+    };
+
+    template <typename ExecutionPolicy>
+    BatchPlan PlanTopDocumentsBatch(ExecutionPolicy policy, const std::vector<std::string>& raw_queries) const;
+
+    template <typename ExecutionPolicy>
+    BatchResults FindTopDocumentsBatchFlat(ExecutionPolicy policy, const std::vector<std::string>& raw_queries, DocumentStatus status) const;
+
+    //Считает группу плана, выдачу её запроса номер lane пишет в slots[lane]
+    void FindTopDocumentsGroup(const BatchPlan& plan, const std::vector<size_t>& group, DocumentStatus status, BatchSlot* slots) const;
+
+    //Стоит ли отбирать top_k обходом документ за документом с отсечением (BlockMaxScorer) вместо полного подсчёта,
+    //если диапазон номеров делится на part_count частей
+    bool UseBlockMaxScoring(const ResolvedQuery& query, size_t top_k, size_t part_count = 1) const;
+
+    //Считает до BatchScoreAccumulator::LANE_COUNT запросов за один проход по объединению их слов, выдачу запроса lane пишет в slots[lane]
+    void FindAllDocumentsBatch(const std::vector<const ResolvedQuery*>& queries, DocumentStatus status, BatchSlot* slots) const;
+
+    //Отбирает top_k самых релевантных документов среди всех подходящих под запрос
+    template <typename DocumentPredicate>
+    std::vector<Document> FindAllDocuments(std::execution::sequenced_policy policy, const ResolvedQuery& query, DocumentPredicate predicate, size_t top_k) const
+    {
+        //Документы с минус-словами собираются в OrdinalSet до подсчёта и не доходят до накопителя.
+        //При обходе документ за документом минус-слова проверяются по ходу обхода
+        const bool use_block_max_scoring = UseBlockMaxScoring(query, top_k);
+        StageTimer timer(use_block_max_scoring ? SearchStage::SCORING : SearchStage::MINUS_FILTERING);
+        const auto accept = [this, &predicate](int ordinal)
+        {
+            const DocumentAttributes& document = ordinal_to_document_[ordinal];
+            return IsLiveDocument(ordinal) && predicate(document.id, document.status, document.rating);
+        };
+        const auto push = [this](TopDocuments& top_documents)
+        {
+            return [this, &top_documents](int ordinal, double relevance)
             {
-                document_to_relevance.erase(document_id);
-            }
+                const DocumentAttributes& document = ordinal_to_document_[ordinal];
+                top_documents.Push(Document{ document.id, relevance, document.rating });
+            };
+        };
+
+        TopDocuments top_documents(top_k);
+        if (use_block_max_scoring)
+        {
+            const ThreadScratch<BlockMaxScorer>::Lease scorer = ThreadScratch<BlockMaxScorer>::Acquire();
+            scorer->Reset(posting_index_, query.plus_terms, query.minus_terms, 0, static_cast<int>(ordinal_to_document_.size()));
+            scorer->Score(top_k, accept);
+            timer.Next(SearchStage::TOP_K);
+            scorer->ForEachDocument(push(top_documents));
+            timer.Next(SearchStage::RESULT_BUILDING);
+            return top_documents.Extract();
         }
 
-        std::vector<Document> matched_documents;
-        for (const auto [document_id, relevance] : document_to_relevance)
+        const ThreadScratch<OrdinalSet>::Lease excluded = ThreadScratch<OrdinalSet>::Acquire();
+        excluded->Reset(0, static_cast<int>(ordinal_to_document_.size()));
+        for (const int term : query.minus_terms)
         {
-            matched_documents.push_back(
-                Document
+            posting_index_.CollectOrdinals(term, *excluded);
+        }
+
+        timer.Next(SearchStage::SCORING);
+        const ThreadScratch<ScoreAccumulator>::Lease accumulator_lease = ThreadScratch<ScoreAccumulator>::Acquire();
+        ScoreAccumulator& accumulator = *accumulator_lease;
+        accumulator.Reset(ordinal_to_document_.size());
+        for (const auto& [term, inverse_document_freq] : query.plus_terms)
+        {
+            posting_index_.ForEachPosting(term,
+                [&, inverse_document_freq = inverse_document_freq](const Posting& posting)
                 {
-                document_id,
-                relevance,
-                documents_.at(document_id).rating
+                    if (!excluded->Contains(posting.ordinal))
+                    {
+                        accumulator.Add(0, posting.ordinal, posting.term_freq * inverse_document_freq, accept);
+                    }
                 });
         }
-        return matched_documents;
+
+        timer.Next(SearchStage::TOP_K);
+        accumulator.ForEachDocument(0, push(top_documents));
+        timer.Next(SearchStage::RESULT_BUILDING);
+        return top_documents.Extract();
     }
 
+    //Диапазон порядковых номеров делится на части, каждая часть считается целиком в своём потоке
+    //и отбирает свои top_k документов, в конце отборы частей сливаются. Этапы внутри частей замеряются в каждой части
     template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(std::execution::parallel_policy policy, const Query& query, DocumentPredicate predicate) const
+    std::vector<Document> FindAllDocuments(std::execution::parallel_policy policy, const ResolvedQuery& query, DocumentPredicate predicate, size_t top_k) const
     {
-        ConcurrentMap<int, double> document_to_relevance_maps(12);
-        /*for (std::string_view word : query.plus_words)
+        const size_t ordinal_count = ordinal_to_document_.size();
+        const size_t part_count = GetScoringPartCount();
+        const ThreadScratch<ScoreAccumulator>::Lease accumulator_lease = ThreadScratch<ScoreAccumulator>::Acquire();
+        ScoreAccumulator& accumulator = *accumulator_lease;
+        accumulator.Reset(ordinal_count, part_count);
+        const auto accept = [this, &predicate](int ordinal)
         {
-            if (word_to_document_freqs_.count(word) == 0)
-            {
-                continue;
-            }
-            const double inverse_document_freq = ComputeWordInverseDocumentFreq(std::string(word));
-            for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word))
-            {
-                auto current_document = documents_.at(document_id);
-                if (predicate(document_id, current_document.status, current_document.rating))
-                {
-                    document_to_relevance_maps[document_id].ref_to_value += term_freq * inverse_document_freq;
-                }
-            }
-        }*/
+            const DocumentAttributes& document = ordinal_to_document_[ordinal];
+            return IsLiveDocument(ordinal) && predicate(document.id, document.status, document.rating);
+        };
+
+        const ThreadScratch<ScoringScratch>::Lease scratch = ThreadScratch<ScoringScratch>::Acquire();
+        std::vector<TopDocuments>& part_top_documents = scratch->part_top_documents;
+        part_top_documents.resize(part_count, TopDocuments(0));
+        for (TopDocuments& top_documents : part_top_documents)
+        {
+            top_documents.Reset(top_k);
+        }
+        std::vector<size_t>& parts = scratch->parts;
+        parts.resize(part_count);
+        std::iota(parts.begin(), parts.end(), 0);
+        const bool use_block_max_scoring = UseBlockMaxScoring(query, top_k, part_count);
         for_each(
             policy,
-            query.plus_words.begin(), query.plus_words.end(),
-            [predicate, this, &document_to_relevance_maps](const auto& word)
+            parts.begin(), parts.end(),
+            [&](size_t part)
             {
-                if (!(word_to_document_freqs_.count(word) == 0))
+                StageTimer timer(use_block_max_scoring ? SearchStage::SCORING : SearchStage::MINUS_FILTERING);
+                const int first_ordinal = static_cast<int>(ordinal_count * part / part_count);
+                const int last_ordinal = static_cast<int>(ordinal_count * (part + 1) / part_count);
+                const auto push = [this, &top_documents = part_top_documents[part]](int ordinal, double relevance)
                 {
-                    const double inverse_document_freq = ComputeWordInverseDocumentFreq(std::string(word));
-                    for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word))
-                    {
-                        auto current_document = documents_.at(document_id);
-                        if (predicate(document_id, current_document.status, current_document.rating))
+                    const DocumentAttributes& document = ordinal_to_document_[ordinal];
+                    top_documents.Push(Document{ document.id, relevance, document.rating });
+                };
+                if (use_block_max_scoring)
+                {
+                    const ThreadScratch<BlockMaxScorer>::Lease scorer = ThreadScratch<BlockMaxScorer>::Acquire();
+                    scorer->Reset(posting_index_, query.plus_terms, query.minus_terms, first_ordinal, last_ordinal);
+                    scorer->Score(top_k, accept);
+                    timer.Next(SearchStage::TOP_K);
+                    scorer->ForEachDocument(push);
+                    return;
+                }
+                const ThreadScratch<OrdinalSet>::Lease excluded = ThreadScratch<OrdinalSet>::Acquire();
+                excluded->Reset(first_ordinal, last_ordinal);
+                for (const int term : query.minus_terms)
+                {
+                    posting_index_.CollectOrdinals(term, *excluded);
+                }
+                timer.Next(SearchStage::SCORING);
+                for (const auto& [term, inverse_document_freq] : query.plus_terms)
+                {
+                    posting_index_.ForEachPostingInRange(term, first_ordinal, last_ordinal,
+                        [&, inverse_document_freq = inverse_document_freq](const Posting& posting)
                         {
-                            document_to_relevance_maps[document_id].ref_to_value += term_freq * inverse_document_freq;
-                        }
-                    }
+                            if (!excluded->Contains(posting.ordinal))
+                            {
+                                accumulator.Add(part, posting.ordinal, posting.term_freq * inverse_document_freq, accept);
+                            }
+                        });
                 }
+                timer.Next(SearchStage::TOP_K);
+                accumulator.ForEachDocument(part, push);
             });
 
-        std::map<int, double> document_to_relevance = document_to_relevance_maps.BuildOrdinaryMap();
-
-        for (std::string_view word : query.minus_words)
-        {
-            if (word_to_document_freqs_.count(word) == 0)
-            {
-                continue;
-            }
-            for (const auto [document_id, _] : word_to_document_freqs_.at(word))
-            {
-                document_to_relevance.erase(document_id);
-            }
-        }
-
-        std::vector<Document> matched_documents;
-        for (const auto [document_id, relevance] : document_to_relevance)
+        StageTimer timer(SearchStage::RESULT_BUILDING);
+        for (size_t part = 1; part < part_count; ++part)
         {
-            matched_documents.push_back(
-                Document
-                {
-                document_id,
-                relevance,
-                documents_.at(document_id).rating
-                });
+            part_top_documents[0].Merge(part_top_documents[part]);
         }
-        return matched_documents;
+        return part_top_documents[0].Extract();
     }
 };
 
 std::ostream& operator<<(std::ostream& out, const Document doc);
 
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, DocumentPredicate predicate) const
+std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, DocumentPredicate predicate, size_t top_k) const
 {
-    Query query = ParseQuery(raw_query);
+    StageTimer timer(SearchStage::PARSE);
+    const ThreadScratch<QueryScratch>::Lease scratch = ThreadScratch<QueryScratch>::Acquire();
+    Query& query = scratch->query;
+    ParseQuery(raw_query, query);
 
     sort(query.plus_words.begin(), query.plus_words.end());
     auto plus_words_end = unique(query.plus_words.begin(), query.plus_words.end());
     query.plus_words.resize(distance(query.plus_words.begin(), plus_words_end));
 
-    auto matched_documents = FindAllDocuments(std::execution::seq, query, predicate);
-
-    sort(matched_documents.begin(), matched_documents.end(),
-        [](const Document& lhs, const Document& rhs)
-        {
-            if (std::abs(lhs.relevance - rhs.relevance) < EPSILON)
-            {
-                return lhs.rating > rhs.rating;
-            }
-            else
-            {
-                return lhs.relevance > rhs.relevance;
-            }
-        });
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT)
-    {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
-    }
-    return matched_documents;
+    timer.Next(SearchStage::TERM_LOOKUP);
+    ResolveQuery(query, scratch->resolved);
+    timer.Stop();
+    return FindAllDocuments(std::execution::seq, scratch->resolved, predicate, top_k);
 }
 
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindTopDocuments(std::execution::sequenced_policy policy, const std::string_view raw_query, DocumentPredicate predicate) const
+std::vector<Document> SearchServer::FindTopDocuments(std::execution::sequenced_policy policy, const std::string_view raw_query, DocumentPredicate predicate, size_t top_k) const
 {
-    return FindTopDocuments(raw_query, predicate);
+    return FindTopDocuments(raw_query, predicate, top_k);
 }
 
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindTopDocuments(std::execution::parallel_policy policy, const std::string_view raw_query, DocumentPredicate predicate) const
+std::vector<Document> SearchServer::FindTopDocuments(std::execution::parallel_policy policy, const std::string_view raw_query, DocumentPredicate predicate, size_t top_k) const
 {
-    Query query = ParseQuery(raw_query);
+    StageTimer timer(SearchStage::PARSE);
+    const ThreadScratch<QueryScratch>::Lease scratch = ThreadScratch<QueryScratch>::Acquire();
+    Query& query = scratch->query;
+    ParseQuery(raw_query, query);
 
-    sort
-    (
-        policy,
-        query.plus_words.begin(), query.plus_words.end()
-    );
+    //Слов в запросе единицы, параллельная сортировка обошлась бы дороже последовательной
+    sort(query.plus_words.begin(), query.plus_words.end());
+    auto plus_words_end = unique(query.plus_words.begin(), query.plus_words.end());
+    query.plus_words.resize(distance(query.plus_words.begin(), plus_words_end));
 
-    auto plus_words_end = unique
-    (
-        policy,
-        query.plus_words.begin(), query.plus_words.end()
-    );
+    timer.Next(SearchStage::TERM_LOOKUP);
+    ResolveQuery(query, scratch->resolved);
+    timer.Stop();
+    return FindAllDocuments(policy, scratch->resolved, predicate, top_k);
+}
 
-    query.plus_words.resize(distance(query.plus_words.begin(), plus_words_end));
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, DocumentPredicate predicate) const
+{
+    return FindTopDocuments(raw_query, predicate, MAX_RESULT_DOCUMENT_COUNT);
+}
 
-    auto matched_documents = FindAllDocuments(policy, query, predicate);
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(std::execution::sequenced_policy policy, const std::string_view raw_query, DocumentPredicate predicate) const
+{
+    return FindTopDocuments(raw_query, predicate, MAX_RESULT_DOCUMENT_COUNT);
+}
 
-    sort(
-        policy,
-        matched_documents.begin(), matched_documents.end(),
-        [](const Document& lhs, const Document& rhs)
-        {
-            if (std::abs(lhs.relevance - rhs.relevance) < EPSILON)
-            {
-                return lhs.rating > rhs.rating;
-            }
-            else
-            {
-                return lhs.relevance > rhs.relevance;
-            }
-        });
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT)
-    {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
-    }
-    return matched_documents;
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(std::execution::parallel_policy policy, const std::string_view raw_query, DocumentPredicate predicate) const
+{
+    return FindTopDocuments(policy, raw_query, predicate, MAX_RESULT_DOCUMENT_COUNT);
 }
\ No newline at end of file
@@ -0,0 +1,531 @@
+#include "segmented_search_server.h"
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace
+{
+    const char SEGMENT_PREFIX[] = "segment-";
+    const char SEGMENT_SUFFIX[] = ".snap";
+    const char LOG_PREFIX[] = "wal-";
+    const char LOG_SUFFIX[] = ".log";
+    const char MANIFEST_NAME[] = "MANIFEST";
+    const int MANIFEST_VERSION = 1;
+
+    //fsync файла или каталога по пути. Каталог синхронизируется, чтобы пережили падение созданные,
+    //переименованные и удалённые в нём записи
+    void SyncPath(const string& path)
+    {
+#ifndef _WIN32
+        const int fd = open(path.c_str(), O_RDONLY);
+        if (fd == -1)
+        {
+            throw runtime_error("Can't open " + path);
+        }
+        const bool synced = fsync(fd) == 0;
+        close(fd);
+        if (!synced)
+        {
+            throw runtime_error("Can't sync " + path);
+        }
+#endif
+    }
+}
+
+SegmentedSearchServer::SegmentedSearchServer(const string& directory, const string& stop_words, SegmentedSearchServerOptions options)
+    : directory_(directory)
+    , stop_words_(stop_words)
+    , options_(options)
+    , memory_segment_(stop_words)
+{
+    if (options_.memory_segment_size == 0 || options_.merge_factor < 2)
+    {
+        throw invalid_argument("Invalid segment options");
+    }
+
+    filesystem::create_directories(directory_);
+    const bool is_new = !filesystem::exists(GetManifestPath());
+    if (!is_new)
+    {
+        LoadManifest();
+    }
+    RemoveStrayFiles();
+
+    vector<WriteAheadLogRecord> records;
+    log_ = make_unique<WriteAheadLog>(GetLogPath(log_number_), options_.sync_write_ahead_log, &records);
+    if (is_new)
+    {
+        WriteManifest(GetSegmentNumbers(), log_number_);
+    }
+    Replay(records);
+    if (static_cast<size_t>(memory_segment_.GetDocumentCount()) >= options_.memory_segment_size)
+    {
+        FlushLocked();
+    }
+
+    merge_thread_ = thread([this] { RunMerges(); });
+    RequestMerge();
+}
+
+SegmentedSearchServer::~SegmentedSearchServer()
+{
+    {
+        lock_guard guard(merge_mutex_);
+        stopping_ = true;
+    }
+    merge_condition_.notify_all();
+    merge_thread_.join();
+}
+
+void SegmentedSearchServer::AddDocument(int document_id, string_view document, DocumentStatus status, const vector<int>& ratings)
+{
+    unique_lock guard(mutex_);
+    if (FindSegment(document_id))
+    {
+        throw invalid_argument("id is taken");
+    }
+    memory_segment_.AddDocument(document_id, document, status, ratings);
+    try
+    {
+        log_->AppendAdd(document_id, document, static_cast<int>(status), ratings);
+    }
+    catch (...)
+    {
+        memory_segment_.RemoveDocument(document_id);
+        throw;
+    }
+
+    if (static_cast<size_t>(memory_segment_.GetDocumentCount()) >= options_.memory_segment_size)
+    {
+        FlushLocked();
+    }
+}
+
+void SegmentedSearchServer::RemoveDocument(int document_id)
+{
+    unique_lock guard(mutex_);
+    if (!FindIndex(document_id))
+    {
+        return;
+    }
+    log_->AppendRemove(document_id);
+    RemoveDocumentLocked(document_id);
+}
+
+vector<Document> SegmentedSearchServer::FindTopDocuments(string_view raw_query, DocumentStatus status) const
+{
+    return FindTopDocuments(execution::seq, raw_query, [status](int document_id, DocumentStatus document_status, int rating) { return document_status == status; }, MAX_RESULT_DOCUMENT_COUNT);
+}
+
+vector<Document> SegmentedSearchServer::FindTopDocuments(execution::parallel_policy policy, string_view raw_query, DocumentStatus status) const
+{
+    return FindTopDocuments(policy, raw_query, [status](int document_id, DocumentStatus document_status, int rating) { return document_status == status; }, MAX_RESULT_DOCUMENT_COUNT);
+}
+
+tuple<vector<string>, DocumentStatus> SegmentedSearchServer::MatchDocument(string_view raw_query, int document_id) const
+{
+    shared_lock guard(mutex_);
+    const SearchServer* index = FindIndex(document_id);
+    if (!index)
+    {
+        throw invalid_argument("no document with such id");
+    }
+    const auto [words, status] = index->MatchDocument(raw_query, document_id);
+    return { vector<string>(words.begin(), words.end()), status };
+}
+
+int SegmentedSearchServer::GetDocumentCount() const
+{
+    shared_lock guard(mutex_);
+    int document_count = memory_segment_.GetDocumentCount();
+    for (const Segment& segment : segments_)
+    {
+        document_count += segment.index->GetDocumentCount();
+    }
+    return document_count;
+}
+
+size_t SegmentedSearchServer::GetSegmentCount() const
+{
+    shared_lock guard(mutex_);
+    return segments_.size();
+}
+
+void SegmentedSearchServer::Flush()
+{
+    unique_lock guard(mutex_);
+    FlushLocked();
+}
+
+void SegmentedSearchServer::WaitForMerges()
+{
+    unique_lock lock(merge_mutex_);
+    merge_condition_.wait(lock, [this] { return !merge_requested_ && !merging_; });
+}
+
+string SegmentedSearchServer::GetSegmentPath(uint64_t number) const
+{
+    return (filesystem::path(directory_) / (SEGMENT_PREFIX + to_string(number) + SEGMENT_SUFFIX)).string();
+}
+
+string SegmentedSearchServer::GetLogPath(uint64_t number) const
+{
+    return (filesystem::path(directory_) / (LOG_PREFIX + to_string(number) + LOG_SUFFIX)).string();
+}
+
+string SegmentedSearchServer::GetManifestPath() const
+{
+    return (filesystem::path(directory_) / MANIFEST_NAME).string();
+}
+
+void SegmentedSearchServer::LoadManifest()
+{
+    ifstream in(GetManifestPath());
+    string key;
+    int version = 0;
+    uint64_t next_segment_number = 0;
+    if (!(in >> key >> version) || key != "version" || version != MANIFEST_VERSION
+        || !(in >> key >> log_number_) || key != "log"
+        || !(in >> key >> next_segment_number) || key != "next")
+    {
+        throw invalid_argument("Invalid manifest in " + directory_);
+    }
+    next_segment_number_ = next_segment_number;
+
+    uint64_t number = 0;
+    while (in >> key >> number)
+    {
+        if (key != "segment")
+        {
+            throw invalid_argument("Invalid manifest in " + directory_);
+        }
+        segments_.push_back({ number, make_unique<SearchServer>(SearchServer::Open(GetSegmentPath(number))), {} });
+    }
+}
+
+void SegmentedSearchServer::WriteManifest(const vector<uint64_t>& segment_numbers, uint64_t log_number) const
+{
+    //Манифест подменяется переименованием: после падения на диске либо старый, либо новый список.
+    //Временный файл сбрасывается на диск до переименования, каталог - после, иначе после падения
+    //переименование может оказаться на диске раньше содержимого или не оказаться вовсе
+    const string path = GetManifestPath();
+    const string temporary_path = path + ".tmp";
+    {
+        ofstream out(temporary_path, ios::trunc);
+        out << "version " << MANIFEST_VERSION << "\n";
+        out << "log " << log_number << "\n";
+        out << "next " << next_segment_number_ << "\n";
+        for (const uint64_t number : segment_numbers)
+        {
+            out << "segment " << number << "\n";
+        }
+        if (!out.flush())
+        {
+            throw runtime_error("Can't write " + temporary_path);
+        }
+    }
+    SyncPath(temporary_path);
+    filesystem::rename(temporary_path, path);
+    SyncPath(directory_);
+}
+
+vector<uint64_t> SegmentedSearchServer::GetSegmentNumbers() const
+{
+    vector<uint64_t> numbers;
+    for (const Segment& segment : segments_)
+    {
+        numbers.push_back(segment.number);
+    }
+    return numbers;
+}
+
+void SegmentedSearchServer::RemoveStrayFiles() const
+{
+    //Остатки оборванных сбросов и слияний: файлы сегментов и журналов, которых нет в манифесте
+    for (const auto& entry : filesystem::directory_iterator(directory_))
+    {
+        const string name = entry.path().filename().string();
+        const bool is_segment = name.rfind(SEGMENT_PREFIX, 0) == 0;
+        const bool is_log = name.rfind(LOG_PREFIX, 0) == 0;
+        if (!is_segment && !is_log && name != string(MANIFEST_NAME) + ".tmp")
+        {
+            continue;
+        }
+        const bool is_live = (is_log && entry.path() == filesystem::path(GetLogPath(log_number_)))
+            || any_of(segments_.begin(), segments_.end(),
+                [&](const Segment& segment)
+                {
+                    return entry.path() == filesystem::path(GetSegmentPath(segment.number));
+                });
+        if (!is_live)
+        {
+            filesystem::remove(entry.path());
+        }
+    }
+}
+
+void SegmentedSearchServer::Replay(const vector<WriteAheadLogRecord>& records)
+{
+    //Записи о документах, уже сброшенных в сегменты, могут остаться в журнале после падения - они пропускаются
+    for (const WriteAheadLogRecord& record : records)
+    {
+        if (record.type == WriteAheadLogRecord::Type::REMOVE_DOCUMENT)
+        {
+            if (FindIndex(record.document_id))
+            {
+                RemoveDocumentLocked(record.document_id);
+            }
+        }
+        else if (!FindSegment(record.document_id))
+        {
+            try
+            {
+                memory_segment_.AddDocument(record.document_id, record.text, static_cast<DocumentStatus>(record.status), record.ratings);
+            }
+            catch (const invalid_argument&)
+            {
+            }
+        }
+    }
+}
+
+SegmentedSearchServer::Segment* SegmentedSearchServer::FindSegment(int document_id)
+{
+    for (Segment& segment : segments_)
+    {
+        if (segment.index->documents_.count(document_id) > 0)
+        {
+            return &segment;
+        }
+    }
+    return nullptr;
+}
+
+const SearchServer* SegmentedSearchServer::FindIndex(int document_id) const
+{
+    if (memory_segment_.documents_.count(document_id) > 0)
+    {
+        return &memory_segment_;
+    }
+    for (const Segment& segment : segments_)
+    {
+        if (segment.index->documents_.count(document_id) > 0)
+        {
+            return segment.index.get();
+        }
+    }
+    return nullptr;
+}
+
+void SegmentedSearchServer::RemoveDocumentLocked(int document_id)
+{
+    if (memory_segment_.documents_.count(document_id) > 0)
+    {
+        memory_segment_.RemoveDocument(document_id);
+        return;
+    }
+    Segment* segment = FindSegment(document_id);
+    if (!segment)
+    {
+        return;
+    }
+    segment->index->RemoveDocument(document_id);
+    segment->removed_ids.push_back(document_id);
+
+    lock_guard merge_guard(merge_mutex_);
+    if (find(merging_segments_.begin(), merging_segments_.end(), segment->number) != merging_segments_.end())
+    {
+        removed_during_merge_.push_back(document_id);
+    }
+}
+
+void SegmentedSearchServer::FlushLocked()
+{
+    if (memory_segment_.GetDocumentCount() == 0)
+    {
+        return;
+    }
+
+    const uint64_t number = next_segment_number_++;
+    memory_segment_.Save(GetSegmentPath(number));
+    SyncPath(GetSegmentPath(number));
+    Segment segment{ number, make_unique<SearchServer>(SearchServer::Open(GetSegmentPath(number))), {} };
+
+    //Новый журнал начинается с удалений, которых ещё нет в файлах сегментов
+    const uint64_t new_log_number = log_number_ + 1;
+    filesystem::remove(GetLogPath(new_log_number));
+    auto log = make_unique<WriteAheadLog>(GetLogPath(new_log_number), options_.sync_write_ahead_log);
+    for (const Segment& old_segment : segments_)
+    {
+        for (const int document_id : old_segment.removed_ids)
+        {
+            log->AppendRemove(document_id);
+        }
+    }
+    log->Sync();
+
+    //Запись манифеста - момент фиксации: до неё действуют старый журнал и старый список сегментов,
+    //поэтому состояние в памяти меняется и старый журнал удаляется только после неё
+    vector<uint64_t> segment_numbers = GetSegmentNumbers();
+    segment_numbers.push_back(number);
+    WriteManifest(segment_numbers, new_log_number);
+    segments_.push_back(move(segment));
+    const uint64_t old_log_number = log_number_;
+    log_number_ = new_log_number;
+    log_ = move(log);
+    filesystem::remove(GetLogPath(old_log_number));
+
+    memory_segment_ = SearchServer(stop_words_);
+    RequestMerge();
+}
+
+void SegmentedSearchServer::RequestMerge()
+{
+    {
+        lock_guard guard(merge_mutex_);
+        merge_requested_ = true;
+    }
+    merge_condition_.notify_all();
+}
+
+void SegmentedSearchServer::RunMerges()
+{
+    while (true)
+    {
+        {
+            unique_lock lock(merge_mutex_);
+            merge_condition_.wait(lock, [this] { return stopping_ || merge_requested_; });
+            if (stopping_)
+            {
+                return;
+            }
+            merge_requested_ = false;
+            merging_ = true;
+        }
+
+        while (MergeOnce())
+        {
+            lock_guard guard(merge_mutex_);
+            if (stopping_)
+            {
+                break;
+            }
+        }
+
+        {
+            lock_guard guard(merge_mutex_);
+            merging_ = false;
+        }
+        merge_condition_.notify_all();
+    }
+}
+
+vector<uint64_t> SegmentedSearchServer::PickSegmentsToMerge() const
+{
+    //Сегменты делятся на ярусы по размеру, сливаются первые merge_factor сегментов самого мелкого заполненного яруса
+    vector<vector<uint64_t>> tiers;
+    for (const Segment& segment : segments_)
+    {
+        const double document_count = segment.index->GetDocumentCount();
+        size_t tier = 0;
+        for (double bound = static_cast<double>(options_.memory_segment_size) * options_.merge_factor; document_count >= bound; bound *= options_.merge_factor)
+        {
+            ++tier;
+        }
+        if (tiers.size() <= tier)
+        {
+            tiers.resize(tier + 1);
+        }
+        tiers[tier].push_back(segment.number);
+    }
+
+    for (vector<uint64_t>& tier : tiers)
+    {
+        if (tier.size() >= options_.merge_factor)
+        {
+            tier.resize(options_.merge_factor);
+            return tier;
+        }
+    }
+    return {};
+}
+
+bool SegmentedSearchServer::MergeOnce()
+{
+    //Слитый сегмент строится под разделяемой блокировкой: запросы идут, изменения ждут
+    SearchServer merged(stop_words_);
+    vector<uint64_t> numbers;
+    {
+        shared_lock guard(mutex_);
+        numbers = PickSegmentsToMerge();
+        if (numbers.empty())
+        {
+            return false;
+        }
+        for (const Segment& segment : segments_)
+        {
+            if (find(numbers.begin(), numbers.end(), segment.number) != numbers.end())
+            {
+                merged.AddDocumentsFrom(*segment.index);
+            }
+        }
+        lock_guard merge_guard(merge_mutex_);
+        merging_segments_ = numbers;
+        removed_during_merge_.clear();
+    }
+
+    //Запись на диск - без блокировки
+    const uint64_t number = next_segment_number_++;
+    merged.Save(GetSegmentPath(number));
+    SyncPath(GetSegmentPath(number));
+    Segment merged_segment{ number, make_unique<SearchServer>(SearchServer::Open(GetSegmentPath(number))), {} };
+
+    {
+        unique_lock guard(mutex_);
+        lock_guard merge_guard(merge_mutex_);
+        const auto is_merged = [&](const Segment& segment)
+        {
+            return find(numbers.begin(), numbers.end(), segment.number) != numbers.end();
+        };
+
+        //Слитый сегмент встаёт на место первого из исходных. Сначала фиксируется манифест, затем список в памяти
+        const size_t position = find_if(segments_.begin(), segments_.end(), is_merged) - segments_.begin();
+        vector<uint64_t> segment_numbers;
+        for (size_t i = 0; i < segments_.size(); ++i)
+        {
+            if (i == position)
+            {
+                segment_numbers.push_back(number);
+            }
+            if (!is_merged(segments_[i]))
+            {
+                segment_numbers.push_back(segments_[i].number);
+            }
+        }
+        WriteManifest(segment_numbers, log_number_);
+
+        for (const int document_id : removed_during_merge_)
+        {
+            merged_segment.index->RemoveDocument(document_id);
+            merged_segment.removed_ids.push_back(document_id);
+        }
+        segments_.erase(remove_if(segments_.begin(), segments_.end(), is_merged), segments_.end());
+        segments_.insert(segments_.begin() + position, move(merged_segment));
+
+        merging_segments_.clear();
+        removed_during_merge_.clear();
+    }
+
+    for (const uint64_t old_number : numbers)
+    {
+        filesystem::remove(GetSegmentPath(old_number));
+    }
+    return true;
+}
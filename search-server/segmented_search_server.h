@@ -0,0 +1,156 @@
+#pragma once
+#include "search_server.h"
+#include "write_ahead_log.h"
+#include <vector>
+#include <string>
+#include <string_view>
+#include <memory>
+#include <atomic>
+#include <shared_mutex>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <cmath>
+
+struct SegmentedSearchServerOptions
+{
+    size_t memory_segment_size = 10000;     //Документов в памяти, после которых сегмент сбрасывается на диск
+    size_t merge_factor = 4;                //Столько сегментов одного яруса сливаются в один
+    bool sync_write_ahead_log = false;      //fsync после каждой записи журнала
+};
+
+//Индекс из сегментов (LSM). Изменения дописываются в журнал, новые документы копятся в небольшом изменяемом
+//сегменте в памяти. Заполненный сегмент сбрасывается на диск неизменяемым снимком (см. SearchServer::Save),
+//а фоновый поток сливает сегменты близкого размера (size-tiered): ярус сегмента - сколько раз его размер
+//превосходит размер сегмента в памяти в merge_factor раз. Запросы видят согласованное состояние всех сегментов,
+//IDF считается по числу документов всего корпуса.
+//Каталог индекса: MANIFEST со списком сегментов и номером журнала (заменяется атомарно), segment-N.snap, wal-N.log
+class SegmentedSearchServer
+{
+public:
+    //Открывает каталог индекса, создавая его при необходимости: поднимает сегменты из манифеста и проигрывает журнал
+    SegmentedSearchServer(const std::string& directory, const std::string& stop_words, SegmentedSearchServerOptions options = {});
+    ~SegmentedSearchServer();
+
+    SegmentedSearchServer(const SegmentedSearchServer&) = delete;
+    SegmentedSearchServer& operator=(const SegmentedSearchServer&) = delete;
+
+    //Бросает invalid_argument, как SearchServer::AddDocument, и runtime_error, если не удалось записать журнал
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+
+    //Отсутствующий id пропускается
+    void RemoveDocument(int document_id);
+
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy policy, std::string_view raw_query, DocumentPredicate predicate, size_t top_k) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL) const;
+    std::vector<Document> FindTopDocuments(std::execution::parallel_policy policy, std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL) const;
+
+    //Слова копируются: сегмент, которому они принадлежат, может быть слит и закрыт
+    std::tuple<std::vector<std::string>, DocumentStatus> MatchDocument(std::string_view raw_query, int document_id) const;
+
+    int GetDocumentCount() const;
+
+    //Число сегментов на диске
+    size_t GetSegmentCount() const;
+
+    //Сбрасывает сегмент из памяти на диск и начинает новый журнал
+    void Flush();
+
+    //Ждёт, пока фоновый поток не выполнит все слияния, которых требует политика
+    void WaitForMerges();
+
+private:
+    struct Segment
+    {
+        uint64_t number = 0;
+        std::unique_ptr<SearchServer> index;
+        std::vector<int> removed_ids;               //Удалены после записи файла сегмента, повторяются в каждом новом журнале
+    };
+
+    std::string directory_;
+    std::string stop_words_;
+    SegmentedSearchServerOptions options_;
+
+    mutable std::shared_mutex mutex_;               //Запросы берут разделяемо, изменения - исключительно
+    SearchServer memory_segment_;
+    std::vector<Segment> segments_;                 //Сегменты на диске, от старых к новым
+    std::unique_ptr<WriteAheadLog> log_;
+    uint64_t log_number_ = 0;
+    std::atomic<uint64_t> next_segment_number_{ 0 };
+
+    std::mutex merge_mutex_;                        //Берётся после mutex_, если нужны оба
+    std::condition_variable merge_condition_;
+    bool merge_requested_ = false;
+    bool merging_ = false;
+    bool stopping_ = false;
+    std::vector<uint64_t> merging_segments_;
+    std::vector<int> removed_during_merge_;         //Удалены из сливаемых сегментов, пока слияние шло без блокировки
+    std::thread merge_thread_;
+
+    std::string GetSegmentPath(uint64_t number) const;
+    std::string GetLogPath(uint64_t number) const;
+    std::string GetManifestPath() const;
+
+    void LoadManifest();
+    //Атомарно и надёжно заменяет манифест; segments_ и log_number_ меняются вызывающим только после успешной записи
+    void WriteManifest(const std::vector<uint64_t>& segment_numbers, uint64_t log_number) const;
+    std::vector<uint64_t> GetSegmentNumbers() const;
+    void RemoveStrayFiles() const;
+    void Replay(const std::vector<WriteAheadLogRecord>& records);
+
+    //Сегмент на диске, в котором есть документ, или nullptr
+    Segment* FindSegment(int document_id);
+    const SearchServer* FindIndex(int document_id) const;
+
+    void RemoveDocumentLocked(int document_id);
+    void FlushLocked();
+    void RequestMerge();
+
+    void RunMerges();
+    std::vector<uint64_t> PickSegmentsToMerge() const;
+    bool MergeOnce();
+};
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> SegmentedSearchServer::FindTopDocuments(ExecutionPolicy policy, std::string_view raw_query, DocumentPredicate predicate, size_t top_k) const
+{
+    std::shared_lock guard(mutex_);
+    SearchServer::Query query = memory_segment_.ParseQuery(raw_query);
+    std::sort(query.plus_words.begin(), query.plus_words.end());
+    query.plus_words.erase(std::unique(query.plus_words.begin(), query.plus_words.end()), query.plus_words.end());
+
+    std::vector<const SearchServer*> indexes{ &memory_segment_ };
+    for (const Segment& segment : segments_)
+    {
+        indexes.push_back(segment.index.get());
+    }
+
+    //IDF по всему корпусу - той же формулой, что и внутри SearchServer
+    int document_count = 0;
+    std::vector<int> word_document_counts(query.plus_words.size(), 0);
+    for (const SearchServer* index : indexes)
+    {
+        document_count += index->GetDocumentCount();
+        for (size_t i = 0; i < query.plus_words.size(); ++i)
+        {
+            word_document_counts[i] += index->GetWordDocumentCount(query.plus_words[i]);
+        }
+    }
+    const double log_document_count = std::log(static_cast<double>(document_count));
+    const auto inverse_document_freq = [&](std::string_view word, int term)
+    {
+        const size_t i = std::lower_bound(query.plus_words.begin(), query.plus_words.end(), word) - query.plus_words.begin();
+        return log_document_count - std::log(static_cast<double>(word_document_counts[i]));
+    };
+
+    TopDocuments top_documents(top_k);
+    for (const SearchServer* index : indexes)
+    {
+        for (const Document& document : index->FindAllDocuments(policy, index->ResolveQuery(query, inverse_document_freq), predicate, top_k))
+        {
+            top_documents.Push(document);
+        }
+    }
+    return top_documents.Extract();
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <cstddef>
+
+class MappedFile;
+
+//Неизменяемый для читателей массив, который копируется за O(1): копии делят элементы, лежащие либо в общем
+//векторе, либо в отображённом файле. Изменять можно только через GetOwned - общие данные при этом сначала
+//копируются (копирование при записи), так что копии, которые держат другие потоки, не меняются
+template <typename T>
+class SharedArray
+{
+public:
+    SharedArray() = default;
+
+    SharedArray(std::vector<T> values)
+        : values_(std::make_shared<std::vector<T>>(std::move(values)))
+    {
+    }
+
+    SharedArray(std::shared_ptr<const MappedFile> file, const T* data, size_t size)
+        : file_(std::move(file))
+        , mapped_data_(data)
+        , mapped_size_(size)
+    {
+    }
+
+    const T* data() const
+    {
+        return file_ ? mapped_data_ : values_ ? values_->data() : nullptr;
+    }
+
+    size_t size() const
+    {
+        return file_ ? mapped_size_ : values_ ? values_->size() : 0;
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+    const T* begin() const
+    {
+        return data();
+    }
+
+    const T* end() const
+    {
+        return data() + size();
+    }
+
+    const T& operator[](size_t index) const
+    {
+        return data()[index];
+    }
+
+    //Элементы для изменения, при необходимости скопированные из файла или из общего вектора
+    std::vector<T>& GetOwned()
+    {
+        if (file_)
+        {
+            values_ = std::make_shared<std::vector<T>>(mapped_data_, mapped_data_ + mapped_size_);
+            file_.reset();
+            mapped_data_ = nullptr;
+            mapped_size_ = 0;
+        }
+        else if (!values_)
+        {
+            values_ = std::make_shared<std::vector<T>>();
+        }
+        else if (values_.use_count() > 1)
+        {
+            values_ = std::make_shared<std::vector<T>>(*values_);
+        }
+        //Если последняя чужая копия только что уничтожена в другом потоке, её чтения должны закончиться до наших записей
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return *values_;
+    }
+
+private:
+    std::shared_ptr<std::vector<T>> values_;
+    std::shared_ptr<const MappedFile> file_;
+    const T* mapped_data_ = nullptr;
+    size_t mapped_size_ = 0;
+};
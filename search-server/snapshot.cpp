@@ -0,0 +1,207 @@
+#include "snapshot.h"
+#include "posting_index.h"
+#include <cstring>
+#include <cstdio>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace
+{
+    const uint64_t SECTION_ALIGNMENT = 64;
+    const size_t PREFETCH_STRIDE = 4096;
+}
+
+MappedFile::MappedFile(const string& path)
+{
+#ifndef _WIN32
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+    {
+        throw runtime_error("Can't open " + path);
+    }
+    struct stat info;
+    if (fstat(fd, &info) == -1)
+    {
+        close(fd);
+        throw runtime_error("Can't stat " + path);
+    }
+    size_ = static_cast<size_t>(info.st_size);
+    //Пустой файл отобразить нельзя, он остаётся с нулевым размером
+    if (size_ == 0)
+    {
+        close(fd);
+        return;
+    }
+    void* data = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        throw runtime_error("Can't map " + path);
+    }
+    data_ = static_cast<const char*>(data);
+#else
+    ifstream in(path, ios::binary | ios::ate);
+    if (!in)
+    {
+        throw runtime_error("Can't open " + path);
+    }
+    buffer_.resize(static_cast<size_t>(in.tellg()));
+    in.seekg(0);
+    in.read(buffer_.data(), buffer_.size());
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+#ifndef _WIN32
+    if (size_ != 0)
+    {
+        munmap(const_cast<char*>(data_), size_);
+    }
+#endif
+}
+
+const char* MappedFile::GetData() const
+{
+    return data_;
+}
+
+size_t MappedFile::GetSize() const
+{
+    return size_;
+}
+
+void MappedFile::Prefetch() const
+{
+#ifndef _WIN32
+    madvise(const_cast<char*>(data_), size_, MADV_WILLNEED);
+#endif
+    volatile char sink = 0;
+    for (size_t offset = 0; offset < size_; offset += PREFETCH_STRIDE)
+    {
+        sink = sink + data_[offset];
+    }
+}
+
+SnapshotWriter::SnapshotWriter(const string& path)
+    : path_(path)
+    , temporary_path_(path + ".tmp")
+    , out_(temporary_path_, ios::binary | ios::trunc)
+{
+    if (!out_)
+    {
+        throw runtime_error("Can't create " + temporary_path_);
+    }
+    header_.posting_block_size = sizeof(PostingBlock);
+    //Место под заголовок, настоящий заголовок пишется в Finish
+    const SnapshotHeader placeholder;
+    Write(reinterpret_cast<const char*>(&placeholder), sizeof(placeholder));
+}
+
+void SnapshotWriter::BeginSection(SnapshotSection section)
+{
+    static const char zeros[SECTION_ALIGNMENT] = {};
+    section_ = SnapshotSection::COUNT;
+    Write(zeros, (SECTION_ALIGNMENT - position_ % SECTION_ALIGNMENT) % SECTION_ALIGNMENT);
+    section_ = section;
+    header_.sections[static_cast<size_t>(section)] = { position_, 0 };
+}
+
+void SnapshotWriter::Write(const char* data, size_t size)
+{
+    out_.write(data, size);
+    position_ += size;
+    if (section_ != SnapshotSection::COUNT)
+    {
+        header_.sections[static_cast<size_t>(section_)].size = position_ - header_.sections[static_cast<size_t>(section_)].offset;
+    }
+}
+
+void SnapshotWriter::Finish()
+{
+    out_.seekp(0);
+    out_.write(reinterpret_cast<const char*>(&header_), sizeof(header_));
+    out_.close();
+    if (!out_ || rename(temporary_path_.c_str(), path_.c_str()) != 0)
+    {
+        remove(temporary_path_.c_str());
+        throw runtime_error("Can't write " + path_);
+    }
+}
+
+SnapshotReader::SnapshotReader(const string& path, bool prefetch)
+    : file_(make_shared<MappedFile>(path))
+{
+    if (file_->GetSize() < sizeof(SnapshotHeader))
+    {
+        throw invalid_argument("Invalid snapshot: truncated header");
+    }
+    header_ = reinterpret_cast<const SnapshotHeader*>(file_->GetData());
+    const SnapshotHeader expected;
+    if (memcmp(header_->magic, expected.magic, sizeof(expected.magic)) != 0)
+    {
+        throw invalid_argument("Invalid snapshot: bad magic");
+    }
+    if (header_->version != SNAPSHOT_VERSION)
+    {
+        throw invalid_argument("Invalid snapshot: unsupported version " + to_string(header_->version));
+    }
+    if (header_->byte_order_mark != expected.byte_order_mark || header_->posting_block_size != sizeof(PostingBlock)
+        || header_->section_count != expected.section_count)
+    {
+        throw invalid_argument("Invalid snapshot: written on an incompatible platform");
+    }
+    for (const SnapshotHeader::Section& section : header_->sections)
+    {
+        if (section.offset > file_->GetSize() || section.size > file_->GetSize() - section.offset)
+        {
+            throw invalid_argument("Invalid snapshot: section out of file bounds");
+        }
+    }
+
+    if (prefetch)
+    {
+        file_->Prefetch();
+    }
+}
+
+vector<string_view> SnapshotReader::GetStrings(SnapshotSection text_section, SnapshotSection offsets_section) const
+{
+    const SnapshotHeader::Section& text = GetEntry(text_section);
+    const SharedArray<uint64_t> offsets = GetSection<uint64_t>(offsets_section);
+    if (offsets.empty() || offsets[offsets.size() - 1] != text.size)
+    {
+        throw invalid_argument("Invalid snapshot: bad string offsets");
+    }
+
+    vector<string_view> strings;
+    strings.reserve(offsets.size() - 1);
+    for (size_t i = 0; i + 1 < offsets.size(); ++i)
+    {
+        if (offsets[i] > offsets[i + 1])
+        {
+            throw invalid_argument("Invalid snapshot: bad string offsets");
+        }
+        strings.emplace_back(file_->GetData() + text.offset + offsets[i], offsets[i + 1] - offsets[i]);
+    }
+    return strings;
+}
+
+const shared_ptr<const MappedFile>& SnapshotReader::GetFile() const
+{
+    return file_;
+}
+
+const SnapshotHeader::Section& SnapshotReader::GetEntry(SnapshotSection section) const
+{
+    return header_->sections[static_cast<size_t>(section)];
+}
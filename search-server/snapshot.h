@@ -0,0 +1,160 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <string_view>
+#include <memory>
+#include <fstream>
+#include <stdexcept>
+#include <cstdint>
+#include <cstddef>
+#include "shared_array.h"
+#include "chunked_array.h"
+
+//Формат снимка индекса: заголовок с таблицей разделов, затем разделы, выровненные по 64 байтам.
+//В таблице хранятся смещения от начала файла, поэтому снимок не зависит от адреса, по которому он отображён.
+//Числа записываются в порядке байтов машины, заголовок хранит метку порядка и размер блока вхождений для проверки
+const uint32_t SNAPSHOT_VERSION = 3;
+
+enum class SnapshotSection : uint32_t
+{
+    STOP_WORDS_TEXT,
+    STOP_WORD_OFFSETS,
+    TERMS_TEXT,
+    TERM_OFFSETS,
+    POSTING_FIRST_BLOCKS,
+    POSTING_LENGTHS,
+    POSTING_MAX_TERM_FREQS,
+    POSTING_BLOCKS,
+    POSTING_DATA,
+    TERM_FREQS,
+    FORWARD_OFFSETS,
+    FORWARD_LENGTHS,
+    FORWARD_TERMS,
+    FORWARD_TERM_FREQS,
+    DOCUMENTS,
+    COUNT
+};
+
+struct SnapshotHeader
+{
+    char magic[8] = { 'S', 'R', 'C', 'H', 'S', 'N', 'A', 'P' };
+    uint32_t version = SNAPSHOT_VERSION;
+    uint32_t byte_order_mark = 0x01020304;
+    uint32_t posting_block_size = 0;
+    uint32_t section_count = static_cast<uint32_t>(SnapshotSection::COUNT);
+
+    struct Section
+    {
+        uint64_t offset = 0;
+        uint64_t size = 0;                                  //В байтах
+    };
+    Section sections[static_cast<size_t>(SnapshotSection::COUNT)];
+};
+
+//Файл, отображённый в память только для чтения. Страницы разделяются всеми процессами, открывшими тот же файл
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* GetData() const;
+    size_t GetSize() const;
+
+    //Просит ядро подгрузить файл и проходит по всем страницам, чтобы первые запросы не ждали диска
+    void Prefetch() const;
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    std::vector<char> buffer_;                              //Без mmap файл читается сюда целиком
+};
+
+//Пишет снимок во временный файл и переименовывает его в path в Finish, так что читатели никогда не видят
+//недописанный снимок. Разделы пишутся по одному: BeginSection, затем любое число Append
+class SnapshotWriter
+{
+public:
+    explicit SnapshotWriter(const std::string& path);
+
+    void BeginSection(SnapshotSection section);
+
+    template <typename T>
+    void Append(const T* data, size_t count)
+    {
+        Write(reinterpret_cast<const char*>(data), count * sizeof(T));
+    }
+
+    template <typename T>
+    void WriteSection(SnapshotSection section, const T* data, size_t count)
+    {
+        BeginSection(section);
+        Append(data, count);
+    }
+
+    //Строки одним блоком текста и смещения их начал (на одно больше, чем строк)
+    template <typename Strings>
+    void WriteStrings(SnapshotSection text_section, SnapshotSection offsets_section, const Strings& strings)
+    {
+        std::vector<uint64_t> offsets{ 0 };
+        BeginSection(text_section);
+        for (std::string_view str : strings)
+        {
+            Append(str.data(), str.size());
+            offsets.push_back(offsets.back() + str.size());
+        }
+        WriteSection(offsets_section, offsets.data(), offsets.size());
+    }
+
+    void Finish();
+
+private:
+    std::string path_;
+    std::string temporary_path_;
+    std::ofstream out_;
+    SnapshotHeader header_;
+    uint64_t position_ = 0;
+    SnapshotSection section_ = SnapshotSection::COUNT;
+
+    void Write(const char* data, size_t size);
+};
+
+//Отображает снимок и проверяет заголовок. Бросает invalid_argument, если файл не является снимком этой версии
+class SnapshotReader
+{
+public:
+    SnapshotReader(const std::string& path, bool prefetch);
+
+    template <typename T>
+    SharedArray<T> GetSection(SnapshotSection section) const
+    {
+        const SnapshotHeader::Section& entry = GetEntry(section);
+        if (entry.size % sizeof(T) != 0 || entry.offset % alignof(T) != 0)
+        {
+            throw std::invalid_argument("Invalid snapshot: misaligned section");
+        }
+        return SharedArray<T>(file_, reinterpret_cast<const T*>(file_->GetData() + entry.offset), entry.size / sizeof(T));
+    }
+
+    //Раздел для таблиц, которые меняются по одному элементу: изменение копирует из файла только свой кусок
+    template <typename T>
+    ChunkedArray<T> GetChunkedSection(SnapshotSection section) const
+    {
+        const SharedArray<T> array = GetSection<T>(section);
+        return ChunkedArray<T>(file_, array.data(), array.size());
+    }
+
+    //Строки, записанные WriteStrings. string_view смотрят прямо в файл
+    std::vector<std::string_view> GetStrings(SnapshotSection text_section, SnapshotSection offsets_section) const;
+
+    const std::shared_ptr<const MappedFile>& GetFile() const;
+
+private:
+    std::shared_ptr<const MappedFile> file_;
+    const SnapshotHeader* header_ = nullptr;
+
+    const SnapshotHeader::Section& GetEntry(SnapshotSection section) const;
+};
@@ -0,0 +1,120 @@
+#include "stage_profiler.h"
+#include <algorithm>
+
+using namespace std;
+
+string_view GetStageName(SearchStage stage)
+{
+    static const string_view names[] = { "parse", "term_lookup", "scoring", "minus_filtering", "top_k", "result_building" };
+    return names[static_cast<size_t>(stage)];
+}
+
+void StageSnapshot::WriteText(ostream& out) const
+{
+    for (size_t stage = 0; stage < SEARCH_STAGE_COUNT; ++stage)
+    {
+        const LatencyHistogram& histogram = stages[stage];
+        out << GetStageName(static_cast<SearchStage>(stage)) << ": count=" << histogram.GetCount()
+            << " p50=" << histogram.GetPercentile(0.5) << "ns p99=" << histogram.GetPercentile(0.99)
+            << "ns p999=" << histogram.GetPercentile(0.999) << "ns max=" << histogram.GetMax() << "ns\n";
+    }
+}
+
+void StageSnapshot::WriteJson(ostream& out) const
+{
+    out << '{';
+    for (size_t stage = 0; stage < SEARCH_STAGE_COUNT; ++stage)
+    {
+        const LatencyHistogram& histogram = stages[stage];
+        out << (stage == 0 ? "" : ",") << '"' << GetStageName(static_cast<SearchStage>(stage)) << "\":{"
+            << "\"count\":" << histogram.GetCount()
+            << ",\"p50_ns\":" << histogram.GetPercentile(0.5)
+            << ",\"p99_ns\":" << histogram.GetPercentile(0.99)
+            << ",\"p999_ns\":" << histogram.GetPercentile(0.999)
+            << ",\"max_ns\":" << histogram.GetMax() << '}';
+    }
+    out << '}';
+}
+
+StageProfiler& StageProfiler::Instance()
+{
+    //Не уничтожается: потоки пула могут завершаться и сливать свои гистограммы уже после выхода из main
+    static StageProfiler* profiler = new StageProfiler();
+    return *profiler;
+}
+
+void StageProfiler::SetSamplingInterval(uint32_t interval)
+{
+    sampling_interval_.store(interval, memory_order_relaxed);
+}
+
+void StageProfiler::Record(SearchStage stage, uint64_t nanoseconds)
+{
+    GetThreadHistograms()[static_cast<size_t>(stage)].AddFromSingleWriter(nanoseconds);
+}
+
+StageSnapshot StageProfiler::GetSnapshot() const
+{
+    StageSnapshot snapshot;
+    lock_guard guard(mutex_);
+    for (size_t stage = 0; stage < SEARCH_STAGE_COUNT; ++stage)
+    {
+        snapshot.stages[stage].Merge(retired_[stage]);
+        for (const shared_ptr<ThreadHistograms>& histograms : threads_)
+        {
+            snapshot.stages[stage].Merge((*histograms)[stage]);
+        }
+    }
+    return snapshot;
+}
+
+void StageProfiler::Reset()
+{
+    lock_guard guard(mutex_);
+    for (size_t stage = 0; stage < SEARCH_STAGE_COUNT; ++stage)
+    {
+        retired_[stage].Reset();
+        for (const shared_ptr<ThreadHistograms>& histograms : threads_)
+        {
+            (*histograms)[stage].Reset();
+        }
+    }
+}
+
+StageProfiler::ThreadHistograms& StageProfiler::GetThreadHistograms()
+{
+    thread_local ThreadSlot slot;
+    if (!slot.histograms)
+    {
+        slot.histograms = make_shared<ThreadHistograms>();
+        lock_guard guard(mutex_);
+        threads_.push_back(slot.histograms);
+    }
+    return *slot.histograms;
+}
+
+uint64_t StageProfiler::GetThreadSeed()
+{
+    //splitmix64 от номера потока: у соседних номеров состояния далеки друг от друга
+    static atomic<uint64_t> thread_count{ 0 };
+    uint64_t seed = (thread_count.fetch_add(1, memory_order_relaxed) + 1) * 0x9E3779B97F4A7C15ull;
+    seed = (seed ^ (seed >> 30)) * 0xBF58476D1CE4E5B9ull;
+    seed = (seed ^ (seed >> 27)) * 0x94D049BB133111EBull;
+    seed ^= seed >> 31;
+    return seed == 0 ? 1 : seed;
+}
+
+StageProfiler::ThreadSlot::~ThreadSlot()
+{
+    if (!histograms)
+    {
+        return;
+    }
+    StageProfiler& profiler = Instance();
+    lock_guard guard(profiler.mutex_);
+    for (size_t stage = 0; stage < SEARCH_STAGE_COUNT; ++stage)
+    {
+        profiler.retired_[stage].Merge((*histograms)[stage]);
+    }
+    profiler.threads_.erase(find(profiler.threads_.begin(), profiler.threads_.end(), histograms));
+}
@@ -0,0 +1,161 @@
+#pragma once
+#include "latency_histogram.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+//Этапы поиска, время которых измеряется
+enum class SearchStage
+{
+    PARSE,              //Разбор запроса
+    TERM_LOOKUP,        //Поиск слов в словаре и IDF
+    SCORING,            //Проход по спискам вхождений плюс-слов
+    MINUS_FILTERING,    //Исключение документов с минус-словами
+    TOP_K,              //Отбор лучших документов
+    RESULT_BUILDING,    //Слияние отборов и сборка выдачи
+    COUNT
+};
+
+const size_t SEARCH_STAGE_COUNT = static_cast<size_t>(SearchStage::COUNT);
+
+std::string_view GetStageName(SearchStage stage);
+
+//Гистограммы времени этапов в наносекундах, собранные со всех потоков
+struct StageSnapshot
+{
+    std::array<LatencyHistogram, SEARCH_STAGE_COUNT> stages;
+
+    const LatencyHistogram& Get(SearchStage stage) const
+    {
+        return stages[static_cast<size_t>(stage)];
+    }
+
+    //Строка на этап: число измерений, p50, p99, p999 и максимум
+    void WriteText(std::ostream& out) const;
+    void WriteJson(std::ostream& out) const;
+};
+
+//Замеры этапов поиска. Каждый поток пишет в свои гистограммы без блокировок и атомарных сложений,
+//GetSnapshot складывает гистограммы всех живых потоков и уже завершившихся.
+//Чтение часов дороже коротких этапов, поэтому замеряется в среднем один StageTimer из SamplingInterval
+//(по умолчанию DEFAULT_SAMPLING_INTERVAL), выбранный случайно: распределения от этого не смещаются, а остальные
+//запросы платят за профилировщик шагом генератора
+class StageProfiler
+{
+public:
+    static const uint32_t DEFAULT_SAMPLING_INTERVAL = 16;
+
+    static StageProfiler& Instance();
+
+    //1 - замерять всё, 0 - выключить
+    void SetSamplingInterval(uint32_t interval);
+
+    //Решает, замерять ли очередной StageTimer этого потока: случайно, с вероятностью 1 / interval. Счётчик
+    //с шагом interval у запросов с постоянным числом таймеров замерял бы всегда одни и те же этапы
+    bool ShouldSample() const
+    {
+        const uint32_t interval = sampling_interval_.load(std::memory_order_relaxed);
+        if (interval == 0)
+        {
+            return false;
+        }
+        //xorshift64*: пара сдвигов и умножение, состояние не бывает нулевым
+        thread_local uint64_t state = GetThreadSeed();
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return static_cast<uint32_t>((state * 0x2545F4914F6CDD1Dull) >> 32) % interval == 0;
+    }
+
+    void Record(SearchStage stage, uint64_t nanoseconds);
+
+    StageSnapshot GetSnapshot() const;
+
+    //Обнуляет гистограммы. Замеры, идущие в этот момент в других потоках, могут уцелеть
+    void Reset();
+
+private:
+    using ThreadHistograms = std::array<LatencyHistogram, SEARCH_STAGE_COUNT>;
+
+    //Гистограммы потока, при завершении потока сливаются в retired_
+    struct ThreadSlot
+    {
+        std::shared_ptr<ThreadHistograms> histograms;
+        ~ThreadSlot();
+    };
+
+    std::atomic<uint32_t> sampling_interval_{ DEFAULT_SAMPLING_INTERVAL };
+    mutable std::mutex mutex_;
+    std::vector<std::shared_ptr<ThreadHistograms>> threads_;
+    ThreadHistograms retired_;
+
+    StageProfiler() = default;
+
+    ThreadHistograms& GetThreadHistograms();
+
+    //Ненулевое начальное состояние генератора выборки, своё у каждого потока
+    static uint64_t GetThreadSeed();
+};
+
+//Замеряет этапы подряд: от создания до Next - первый этап, от Next до следующего Next или Stop - следующий.
+//Один вызов часов на границу этапов. Деструктор завершает текущий этап. Незамеряемый таймер часы не читает
+class StageTimer
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit StageTimer(SearchStage stage)
+        : stage_(stage)
+        , enabled_(StageProfiler::Instance().ShouldSample())
+    {
+        if (enabled_)
+        {
+            start_ = Clock::now();
+        }
+    }
+
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+
+    ~StageTimer()
+    {
+        Stop();
+    }
+
+    void Next(SearchStage stage)
+    {
+        if (enabled_)
+        {
+            const Clock::time_point now = Clock::now();
+            Record(now);
+            start_ = now;
+        }
+        stage_ = stage;
+    }
+
+    void Stop()
+    {
+        if (enabled_)
+        {
+            Record(Clock::now());
+            enabled_ = false;
+        }
+    }
+
+private:
+    SearchStage stage_;
+    bool enabled_;
+    Clock::time_point start_;
+
+    void Record(Clock::time_point now) const
+    {
+        StageProfiler::Instance().Record(stage_, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now - start_).count()));
+    }
+};
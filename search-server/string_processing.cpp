@@ -1,7 +1,182 @@
 #include "string_processing.h"
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
 
 using namespace std;
 
+namespace
+{
+    int CountTrailingZeros(uint32_t mask)
+    {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward(&index, mask);
+        return static_cast<int>(index);
+#else
+        return __builtin_ctz(mask);
+#endif
+    }
+
+    bool IsForbiddenChar(char c)
+    {
+        return c > 0 && c < 32;
+    }
+
+#if defined(__AVX2__)
+    const size_t BLOCK_SIZE = 32;
+
+    //Маски пробелов и запрещённых символов блока: бит i соответствует байту i
+    void ScanBlock(const char* data, uint32_t& spaces, uint32_t& forbidden)
+    {
+        const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+        spaces = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, _mm256_set1_epi8(' '))));
+        const __m256i is_positive = _mm256_cmpgt_epi8(block, _mm256_setzero_si256());
+        const __m256i is_control = _mm256_cmpgt_epi8(_mm256_set1_epi8(32), block);
+        forbidden = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_and_si256(is_positive, is_control)));
+    }
+#elif defined(__SSE2__) || defined(_M_X64)
+    const size_t BLOCK_SIZE = 16;
+
+    void ScanBlock(const char* data, uint32_t& spaces, uint32_t& forbidden)
+    {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+        spaces = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, _mm_set1_epi8(' '))));
+        const __m128i is_positive = _mm_cmpgt_epi8(block, _mm_setzero_si128());
+        const __m128i is_control = _mm_cmplt_epi8(block, _mm_set1_epi8(32));
+        forbidden = static_cast<uint32_t>(_mm_movemask_epi8(_mm_and_si128(is_positive, is_control)));
+    }
+#else
+    const size_t BLOCK_SIZE = 16;
+
+    void ScanBlock(const char* data, uint32_t& spaces, uint32_t& forbidden)
+    {
+        spaces = 0;
+        forbidden = 0;
+        for (size_t i = 0; i < BLOCK_SIZE; ++i)
+        {
+            spaces |= static_cast<uint32_t>(data[i] == ' ') << i;
+            forbidden |= static_cast<uint32_t>(IsForbiddenChar(data[i])) << i;
+        }
+    }
+#endif
+
+    //Находит границы слов блоками по BLOCK_SIZE байт: слово начинается и заканчивается там, где
+    //меняется бит в маске пробелов. Для каждого слова вызывает on_word. При check_forbidden
+    //прерывается и возвращает false на первом блоке с запрещённым символом
+    template <bool check_forbidden, typename Function>
+    bool ScanWords(string_view text, Function on_word)
+    {
+        const char* data = text.data();
+        const size_t size = text.size();
+        size_t word_begin = 0;
+        uint32_t previous_is_space = 1;
+        size_t pos = 0;
+
+        for (; pos + BLOCK_SIZE <= size; pos += BLOCK_SIZE)
+        {
+            uint32_t spaces, forbidden;
+            ScanBlock(data + pos, spaces, forbidden);
+            if (check_forbidden && forbidden != 0)
+            {
+                return false;
+            }
+
+            const uint32_t block_mask = static_cast<uint32_t>((uint64_t(1) << BLOCK_SIZE) - 1);
+            uint32_t transitions = (spaces ^ ((spaces << 1) | previous_is_space)) & block_mask;
+            while (transitions != 0)
+            {
+                const int i = CountTrailingZeros(transitions);
+                transitions &= transitions - 1;
+                if (spaces & (1u << i))
+                {
+                    on_word(string_view(data + word_begin, pos + i - word_begin));
+                }
+                else
+                {
+                    word_begin = pos + i;
+                }
+            }
+            previous_is_space = (spaces >> (BLOCK_SIZE - 1)) & 1;
+        }
+
+        for (; pos < size; ++pos)
+        {
+            const char c = data[pos];
+            if (check_forbidden && IsForbiddenChar(c))
+            {
+                return false;
+            }
+            const uint32_t is_space = c == ' ';
+            if (is_space != previous_is_space)
+            {
+                if (is_space)
+                {
+                    on_word(string_view(data + word_begin, pos - word_begin));
+                }
+                else
+                {
+                    word_begin = pos;
+                }
+            }
+            previous_is_space = is_space;
+        }
+
+        if (!previous_is_space)
+        {
+            on_word(string_view(data + word_begin, size - word_begin));
+        }
+        return true;
+    }
+}
+
+WordSet::WordSet(const WordSet& other)
+    : words_(other.words_)
+{
+    index_.reserve(words_.size());
+    for (const string& word : words_)
+    {
+        index_.insert(word);
+    }
+}
+
+WordSet& WordSet::operator=(const WordSet& other)
+{
+    if (this != &other)
+    {
+        *this = WordSet(other);
+    }
+    return *this;
+}
+
+void WordSet::Add(string_view word)
+{
+    if (!Contains(word))
+    {
+        words_.emplace_back(word);
+        index_.insert(words_.back());
+    }
+}
+
+bool WordSet::Contains(string_view word) const
+{
+    return index_.count(word) > 0;
+}
+
+bool WordSet::IsEmpty() const
+{
+    return words_.empty();
+}
+
+const deque<string>& WordSet::GetWords() const
+{
+    return words_;
+}
+
 string ReadLine()
 {
     string s;
@@ -48,15 +223,30 @@ vector<string> SplitIntoWords(const std::string& text)
 vector<string_view> SplitIntoWordsView(const string_view str) 
 {
     vector<string_view> result;
-    int64_t pos = str.find_first_not_of(" ");
-    const int64_t pos_end = str.npos;
+    ScanWords<false>(str,
+        [&result](string_view word)
+        {
+            result.push_back(word);
+        });
+    return result;
+}
 
-    while (pos != pos_end) 
+bool SplitIntoWordsChecked(string_view text, const WordSet& stop_words, vector<string_view>& words)
+{
+    if (stop_words.IsEmpty())
     {
-        int64_t space = str.find(' ', pos);
-        result.push_back(space == pos_end ? str.substr(pos) : str.substr(pos, space - pos));
-        pos = str.find_first_not_of(" ", space);
+        return ScanWords<true>(text,
+            [&words](string_view word)
+            {
+                words.push_back(word);
+            });
     }
-
-    return result;
+    return ScanWords<true>(text,
+        [&words, &stop_words](string_view word)
+        {
+            if (!stop_words.Contains(word))
+            {
+                words.push_back(word);
+            }
+        });
 }
@@ -1,12 +1,45 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <iostream>
 #include <vector>
+#include <deque>
+#include <unordered_set>
 
 std::string ReadLine();
 
 int ReadLineWithNumber();
 
+//Множество слов, поиск в котором не выделяет память: строки хранятся в deque, индекс - хеш-множество string_view
+class WordSet
+{
+public:
+    WordSet() = default;
+    //Копия строит свой индекс по своим строкам, перемещение строки не двигает
+    WordSet(const WordSet& other);
+    WordSet(WordSet&& other) = default;
+    WordSet& operator=(const WordSet& other);
+    WordSet& operator=(WordSet&& other) = default;
+
+    void Add(std::string_view word);
+
+    bool Contains(std::string_view word) const;
+
+    bool IsEmpty() const;
+
+    //Слова в порядке добавления
+    const std::deque<std::string>& GetWords() const;
+
+private:
+    std::deque<std::string> words_;
+    std::unordered_set<std::string_view> index_;
+};
+
 //Дробит строку в слова
 std::vector<std::string> SplitIntoWords(const std::string& text);
-std::vector<std::string_view> SplitIntoWordsView(std::string_view text);
\ No newline at end of file
+std::vector<std::string_view> SplitIntoWordsView(std::string_view text);
+
+//За один проход дробит текст на слова, проверяет, что в нём нет управляющих символов (коды 1-31),
+//и отбрасывает слова из stop_words. Слова дописываются в words.
+//Возвращает false, если встретился запрещённый символ; words при этом может быть заполнен частично
+bool SplitIntoWordsChecked(std::string_view text, const WordSet& stop_words, std::vector<std::string_view>& words);
@@ -0,0 +1,111 @@
+#include "term_dictionary.h"
+#include <stdexcept>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+
+using namespace std;
+
+namespace
+{
+    const size_t BLOCK_SIZE = 64 * 1024;
+    const size_t MIN_SLOT_COUNT = 16;
+}
+
+TermDictionary::TermDictionary(const SnapshotReader& reader)
+    : terms_(reader.GetStrings(SnapshotSection::TERMS_TEXT, SnapshotSection::TERM_OFFSETS))
+    , file_(reader.GetFile())
+{
+    if (!BuildIndex())
+    {
+        throw invalid_argument("Invalid snapshot: repeated term");
+    }
+}
+
+void TermDictionary::Save(SnapshotWriter& writer) const
+{
+    writer.WriteStrings(SnapshotSection::TERMS_TEXT, SnapshotSection::TERM_OFFSETS, terms_);
+}
+
+int TermDictionary::Intern(string_view word)
+{
+    if (slots_.empty())
+    {
+        BuildIndex();
+    }
+    const size_t slot = FindSlot(word);
+    if (slots_[slot] != NO_TERM)
+    {
+        return slots_[slot];
+    }
+    //В общий блок дописывать нельзя: другая копия словаря могла дописать в него своё
+    if (blocks_.empty() || blocks_.back().use_count() > 1 || last_block_size_ + word.size() > last_block_capacity_)
+    {
+        last_block_capacity_ = max(BLOCK_SIZE, word.size());
+        blocks_.emplace_back(new char[last_block_capacity_]);
+        last_block_size_ = 0;
+    }
+    atomic_thread_fence(memory_order_acquire);
+    char* data = blocks_.back().get() + last_block_size_;
+    copy(word.begin(), word.end(), data);
+    last_block_size_ += word.size();
+
+    const int term = static_cast<int>(terms_.size());
+    terms_.push_back(string_view(data, word.size()));
+    if (terms_.size() * 2 > slots_.size())
+    {
+        BuildIndex();
+    }
+    else
+    {
+        slots_.GetMutable(slot) = term;
+    }
+    return term;
+}
+
+int TermDictionary::Find(string_view word) const
+{
+    return slots_.empty() ? NO_TERM : slots_[FindSlot(word)];
+}
+
+string_view TermDictionary::GetTerm(int term) const
+{
+    return terms_[term];
+}
+
+size_t TermDictionary::GetTermCount() const
+{
+    return terms_.size();
+}
+
+size_t TermDictionary::FindSlot(string_view word) const
+{
+    const size_t mask = slots_.size() - 1;
+    size_t slot = hash<string_view>{}(word) & mask;
+    while (slots_[slot] != NO_TERM && terms_[slots_[slot]] != word)
+    {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+bool TermDictionary::BuildIndex()
+{
+    //Таблица растёт вдвое, так что перестройки в сумме линейны по числу слов
+    size_t slot_count = MIN_SLOT_COUNT;
+    while (slot_count < terms_.size() * 4)
+    {
+        slot_count *= 2;
+    }
+    slots_.assign(slot_count, NO_TERM);
+    for (size_t term = 0; term < terms_.size(); ++term)
+    {
+        const size_t slot = FindSlot(terms_[term]);
+        if (slots_[slot] != NO_TERM)
+        {
+            return false;
+        }
+        slots_.GetMutable(slot) = static_cast<int>(term);
+    }
+    return true;
+}
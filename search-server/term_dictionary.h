@@ -0,0 +1,48 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "snapshot.h"
+#include "chunked_array.h"
+
+//Словарь терминов: каждое различное слово хранится один раз и получает плотный целочисленный id.
+//Слова лежат в блоках, которые только дописываются и делятся между копиями словаря, поэтому
+//string_view слов остаются валидными, пока жива хотя бы одна копия. Таблицы id лежат в ChunkedArray,
+//так что копия словаря и добавление в неё слова не копируют их целиком
+class TermDictionary
+{
+public:
+    static constexpr int NO_TERM = -1;
+
+    TermDictionary() = default;
+    //Словарь, слова которого смотрят прямо в снимок
+    explicit TermDictionary(const SnapshotReader& reader);
+
+    void Save(SnapshotWriter& writer) const;
+
+    //Возвращает id слова, при необходимости добавляя его в словарь
+    int Intern(std::string_view word);
+
+    //Возвращает id слова или NO_TERM, если слова нет в словаре
+    int Find(std::string_view word) const;
+
+    //Слово по id, string_view остаётся валидным всё время жизни словаря
+    std::string_view GetTerm(int term) const;
+
+    size_t GetTermCount() const;
+
+private:
+    ChunkedArray<std::string_view> terms_;                  //id - слово из blocks_ или из снимка
+    std::vector<std::shared_ptr<char[]>> blocks_;           //Дописываются, только пока блоком не владеет другая копия
+    size_t last_block_size_ = 0;                            //Занято байт в последнем блоке
+    size_t last_block_capacity_ = 0;
+    std::shared_ptr<const MappedFile> file_;                //Снимок, в который смотрят слова
+    ChunkedArray<int> slots_;                               //Открытая адресация по хешу слова: id или NO_TERM, заполнена не больше чем наполовину
+
+    //Слот слова: с его id или первый свободный
+    size_t FindSlot(std::string_view word) const;
+
+    //Перестраивает slots_ под текущее число слов. false, если слово повторяется
+    bool BuildIndex();
+};
@@ -0,0 +1,62 @@
+#pragma once
+#include <memory>
+#include <vector>
+
+//Рабочие буферы, переиспользуемые запросами одного потока. Acquire выдаёт свободный экземпляр потока
+//и возвращает его обратно при разрушении Lease, так что после прогрева новых выделений памяти нет.
+//Вложенный запрос в том же потоке (из предиката или задачи, подхваченной потоком, пока он ждёт
+//параллельный алгоритм) получает другой экземпляр и не портит буферы внешнего
+template <typename T>
+class ThreadScratch
+{
+public:
+    class Lease
+    {
+    public:
+        explicit Lease(std::unique_ptr<T> value)
+            : value_(std::move(value))
+        {
+        }
+
+        ~Lease()
+        {
+            GetFree().push_back(std::move(value_));
+        }
+
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+
+        T& operator*() const
+        {
+            return *value_;
+        }
+
+        T* operator->() const
+        {
+            return value_.get();
+        }
+
+    private:
+        std::unique_ptr<T> value_;
+    };
+
+    //Экземпляр нужно вернуть в том же потоке, поэтому Lease живёт только на стеке
+    static Lease Acquire()
+    {
+        std::vector<std::unique_ptr<T>>& free = GetFree();
+        if (free.empty())
+        {
+            return Lease(std::make_unique<T>());
+        }
+        std::unique_ptr<T> value = std::move(free.back());
+        free.pop_back();
+        return Lease(std::move(value));
+    }
+
+private:
+    static std::vector<std::unique_ptr<T>>& GetFree()
+    {
+        thread_local std::vector<std::unique_ptr<T>> free;
+        return free;
+    }
+};
@@ -0,0 +1,69 @@
+#include "top_documents.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+bool IsMoreRelevant(const Document& lhs, const Document& rhs)
+{
+    if (std::abs(lhs.relevance - rhs.relevance) < EPSILON)
+    {
+        if (lhs.rating != rhs.rating)
+        {
+            return lhs.rating > rhs.rating;
+        }
+        return lhs.id < rhs.id;
+    }
+    return lhs.relevance > rhs.relevance;
+}
+
+TopDocuments::TopDocuments(size_t top_k)
+    : top_k_(top_k)
+{
+    heap_.reserve(top_k);
+}
+
+void TopDocuments::Reset(size_t top_k)
+{
+    top_k_ = top_k;
+    heap_.clear();
+    heap_.reserve(top_k);
+}
+
+void TopDocuments::Push(const Document& document)
+{
+    if (heap_.size() < top_k_)
+    {
+        heap_.push_back(document);
+        push_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+    }
+    else if (top_k_ > 0 && IsMoreRelevant(document, heap_.front()))
+    {
+        pop_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+        heap_.back() = document;
+        push_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+    }
+}
+
+void TopDocuments::Merge(const TopDocuments& other)
+{
+    for (const Document& document : other.heap_)
+    {
+        Push(document);
+    }
+}
+
+vector<Document> TopDocuments::Extract()
+{
+    sort_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+    return move(heap_);
+}
+
+size_t TopDocuments::ExtractTo(Document* output)
+{
+    sort_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+    copy(heap_.begin(), heap_.end(), output);
+    const size_t size = heap_.size();
+    heap_.clear();
+    return size;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include "document.h"
+#include <vector>
+#include <cstddef>
+
+const double EPSILON = 1e-6; //Число для сравнения double чисел
+
+//Порядок выдачи: по убыванию релевантности, при равной релевантности - по убыванию рейтинга, затем по id
+bool IsMoreRelevant(const Document& lhs, const Document& rhs);
+
+//Отбирает top_k лучших документов за O(N log K), храня в куче не больше top_k кандидатов
+class TopDocuments
+{
+public:
+    explicit TopDocuments(size_t top_k);
+
+    //Начинает новый отбор, сохраняя выделенную память
+    void Reset(size_t top_k);
+
+    void Push(const Document& document);
+
+    //Добавляет все документы другого отбора с тем же top_k
+    void Merge(const TopDocuments& other);
+
+    //Возвращает отобранные документы в порядке выдачи
+    std::vector<Document> Extract();
+
+    //Пишет отобранные документы в порядке выдачи в output и возвращает их число. Память сохраняется для следующего отбора
+    size_t ExtractTo(Document* output);
+
+private:
+    size_t top_k_;
+    std::vector<Document> heap_;    //На вершине - наименее релевантный из отобранных
+};
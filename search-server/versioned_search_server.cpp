@@ -0,0 +1,66 @@
+#include "versioned_search_server.h"
+
+using namespace std;
+
+VersionedSearchServer::VersionedSearchServer(SearchServer search_server)
+    : current_(make_shared<const SearchServer>(move(search_server)))
+{
+}
+
+VersionedSearchServer::VersionedSearchServer(Generation generation)
+    : current_(move(generation))
+{
+}
+
+VersionedSearchServer::Generation VersionedSearchServer::Pin() const
+{
+    return current_.Load();
+}
+
+VersionedSearchServer VersionedSearchServer::Clone() const
+{
+    return VersionedSearchServer(Pin());
+}
+
+void VersionedSearchServer::AddDocument(int document_id, string_view document, DocumentStatus status, const vector<int>& ratings)
+{
+    Update([&](SearchServer& search_server)
+        {
+            search_server.AddDocument(document_id, document, status, ratings);
+        });
+}
+
+vector<AddDocumentError> VersionedSearchServer::AddDocuments(const vector<NewDocument>& documents)
+{
+    vector<AddDocumentError> errors;
+    Update([&](SearchServer& search_server)
+        {
+            errors = search_server.AddDocuments(execution::par, documents);
+        });
+    return errors;
+}
+
+void VersionedSearchServer::RemoveDocument(int document_id)
+{
+    RemoveDocuments({ document_id });
+}
+
+void VersionedSearchServer::RemoveDocuments(const vector<int>& document_ids)
+{
+    Update([&](SearchServer& search_server)
+        {
+            search_server.RemoveDocuments(document_ids);
+        });
+}
+
+tuple<vector<string>, DocumentStatus> VersionedSearchServer::MatchDocument(string_view raw_query, int document_id) const
+{
+    const Generation generation = Pin();
+    const auto [words, status] = generation->MatchDocument(raw_query, document_id);
+    return { vector<string>(words.begin(), words.end()), status };
+}
+
+int VersionedSearchServer::GetDocumentCount() const
+{
+    return Pin()->GetDocumentCount();
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include "search_server.h"
+#include "rcu_pointer.h"
+#include <vector>
+#include <string>
+#include <string_view>
+#include <memory>
+#include <mutex>
+
+//Индекс, который можно читать из многих потоков во время изменений. Каждое изменение собирает новое
+//неизменяемое поколение индекса и публикует его целиком, запросы работают с поколением, закреплённым в начале,
+//и не ждут писателя. Таблицы документов, словарь, прямой индекс и хвосты списков вхождений хранятся кусками,
+//общими с предыдущим поколением, так что публикация копирует только куски, задетые изменением, а сжатые блоки
+//списков общие целиком до слияния хвостов. Поколение освобождается, когда его отпускает последний читатель
+class VersionedSearchServer
+{
+public:
+    using Generation = std::shared_ptr<const SearchServer>;
+
+    explicit VersionedSearchServer(SearchServer search_server = SearchServer());
+
+    //Текущее поколение. Остаётся неизменным, сколько бы изменений ни было опубликовано после
+    Generation Pin() const;
+
+    //Независимый индекс, начинающий с текущего поколения, за O(1)
+    VersionedSearchServer Clone() const;
+
+    //Применяет function(SearchServer&) к копии текущего поколения и публикует результат одним поколением.
+    //Если function бросает исключение, ничего не публикуется
+    template <typename Function>
+    void Update(Function function);
+
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    std::vector<AddDocumentError> AddDocuments(const std::vector<NewDocument>& documents);
+
+    //Отсутствующий id пропускается
+    void RemoveDocument(int document_id);
+    void RemoveDocuments(const std::vector<int>& document_ids);
+
+    template <typename... Args>
+    std::vector<Document> FindTopDocuments(const Args&... args) const
+    {
+        return Pin()->FindTopDocuments(args...);
+    }
+
+    //Слова копируются: поколение, которому они принадлежат, может быть освобождено
+    std::tuple<std::vector<std::string>, DocumentStatus> MatchDocument(std::string_view raw_query, int document_id) const;
+
+    int GetDocumentCount() const;
+
+private:
+    RcuPointer<SearchServer> current_;
+    std::mutex write_mutex_;                        //Писатели по очереди: каждый строит поколение из предыдущего
+
+    explicit VersionedSearchServer(Generation generation);
+};
+
+template <typename Function>
+void VersionedSearchServer::Update(Function function)
+{
+    std::lock_guard guard(write_mutex_);
+    auto next = std::make_shared<SearchServer>(*current_.Load());
+    function(*next);
+    current_.Store(std::move(next));
+}
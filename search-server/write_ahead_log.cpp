@@ -0,0 +1,207 @@
+#include "write_ahead_log.h"
+#include <fstream>
+#include <filesystem>
+#include <stdexcept>
+#include <cstring>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace
+{
+    const size_t RECORD_HEADER_SIZE = 2 * sizeof(uint32_t);
+
+    //FNV-1a
+    uint32_t ComputeChecksum(string_view data)
+    {
+        uint32_t hash = 2166136261u;
+        for (const char c : data)
+        {
+            hash = (hash ^ static_cast<uint8_t>(c)) * 16777619u;
+        }
+        return hash;
+    }
+
+    template <typename T>
+    void Put(string& out, T value)
+    {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    //Читает значение и сдвигает data, false - если данных не хватило
+    template <typename T>
+    bool Get(string_view& data, T& value)
+    {
+        if (data.size() < sizeof(value))
+        {
+            return false;
+        }
+        memcpy(&value, data.data(), sizeof(value));
+        data.remove_prefix(sizeof(value));
+        return true;
+    }
+
+    bool ParseRecord(string_view payload, WriteAheadLogRecord& record)
+    {
+        uint8_t type = 0;
+        int32_t document_id = 0;
+        if (!Get(payload, type) || !Get(payload, document_id))
+        {
+            return false;
+        }
+        record.document_id = document_id;
+        if (type == static_cast<uint8_t>(WriteAheadLogRecord::Type::REMOVE_DOCUMENT))
+        {
+            record.type = WriteAheadLogRecord::Type::REMOVE_DOCUMENT;
+            return payload.empty();
+        }
+        if (type != static_cast<uint8_t>(WriteAheadLogRecord::Type::ADD_DOCUMENT))
+        {
+            return false;
+        }
+
+        record.type = WriteAheadLogRecord::Type::ADD_DOCUMENT;
+        int32_t status = 0;
+        uint32_t rating_count = 0;
+        if (!Get(payload, status) || !Get(payload, rating_count) || payload.size() < rating_count * sizeof(int32_t))
+        {
+            return false;
+        }
+        record.status = status;
+        record.ratings.resize(rating_count);
+        for (int& rating : record.ratings)
+        {
+            int32_t value = 0;
+            Get(payload, value);
+            rating = value;
+        }
+        uint32_t text_size = 0;
+        if (!Get(payload, text_size) || payload.size() != text_size)
+        {
+            return false;
+        }
+        record.text = string(payload);
+        return true;
+    }
+}
+
+WriteAheadLog::WriteAheadLog(const string& path, bool sync, vector<WriteAheadLogRecord>* records)
+    : path_(path)
+    , sync_(sync)
+{
+    //Разбор существующего журнала: всё после первой неполной или испорченной записи отбрасывается
+    uint64_t valid_size = 0;
+    if (filesystem::exists(path_))
+    {
+        ifstream in(path_, ios::binary);
+        const string content((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+        string_view rest = content;
+        while (rest.size() >= RECORD_HEADER_SIZE)
+        {
+            uint32_t size = 0;
+            uint32_t checksum = 0;
+            string_view header = rest;
+            Get(header, size);
+            Get(header, checksum);
+            if (header.size() < size)
+            {
+                break;
+            }
+            const string_view payload = header.substr(0, size);
+            WriteAheadLogRecord record;
+            if (ComputeChecksum(payload) != checksum || !ParseRecord(payload, record))
+            {
+                break;
+            }
+            if (records)
+            {
+                records->push_back(move(record));
+            }
+            rest = header.substr(size);
+            valid_size += RECORD_HEADER_SIZE + size;
+        }
+        if (valid_size != content.size())
+        {
+            filesystem::resize_file(path_, valid_size);
+        }
+    }
+
+    file_ = fopen(path_.c_str(), "ab");
+    if (!file_)
+    {
+        throw runtime_error("Can't open " + path_);
+    }
+}
+
+WriteAheadLog::~WriteAheadLog()
+{
+    if (file_)
+    {
+        fclose(file_);
+    }
+}
+
+void WriteAheadLog::AppendAdd(int document_id, string_view text, int status, const vector<int>& ratings)
+{
+    buffer_.clear();
+    Put(buffer_, static_cast<uint8_t>(WriteAheadLogRecord::Type::ADD_DOCUMENT));
+    Put(buffer_, static_cast<int32_t>(document_id));
+    Put(buffer_, static_cast<int32_t>(status));
+    Put(buffer_, static_cast<uint32_t>(ratings.size()));
+    for (const int rating : ratings)
+    {
+        Put(buffer_, static_cast<int32_t>(rating));
+    }
+    Put(buffer_, static_cast<uint32_t>(text.size()));
+    buffer_.append(text);
+    Append(buffer_);
+}
+
+void WriteAheadLog::AppendRemove(int document_id)
+{
+    buffer_.clear();
+    Put(buffer_, static_cast<uint8_t>(WriteAheadLogRecord::Type::REMOVE_DOCUMENT));
+    Put(buffer_, static_cast<int32_t>(document_id));
+    Append(buffer_);
+}
+
+void WriteAheadLog::Sync()
+{
+    if (fflush(file_) != 0)
+    {
+        throw runtime_error("Can't write " + path_);
+    }
+#ifndef _WIN32
+    if (fsync(fileno(file_)) != 0)
+    {
+        throw runtime_error("Can't sync " + path_);
+    }
+#endif
+}
+
+const string& WriteAheadLog::GetPath() const
+{
+    return path_;
+}
+
+void WriteAheadLog::Append(const string& payload)
+{
+    string record;
+    record.reserve(RECORD_HEADER_SIZE + payload.size());
+    Put(record, static_cast<uint32_t>(payload.size()));
+    Put(record, ComputeChecksum(payload));
+    record += payload;
+    if (fwrite(record.data(), 1, record.size(), file_) != record.size() || fflush(file_) != 0)
+    {
+        throw runtime_error("Can't write " + path_);
+    }
+#ifndef _WIN32
+    if (sync_ && fsync(fileno(file_)) != 0)
+    {
+        throw runtime_error("Can't sync " + path_);
+    }
+#endif
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <string_view>
+#include <cstdio>
+#include <cstdint>
+
+//Запись журнала: добавление документа со всеми аргументами AddDocument или удаление документа
+struct WriteAheadLogRecord
+{
+    enum class Type : uint8_t
+    {
+        ADD_DOCUMENT = 1,
+        REMOVE_DOCUMENT = 2
+    };
+
+    Type type = Type::ADD_DOCUMENT;
+    int document_id = 0;
+    int status = 0;
+    std::vector<int> ratings;
+    std::string text;
+};
+
+//Журнал упреждающей записи. Каждая запись - длина, контрольная сумма и тело, записи только дописываются в конец.
+//Запись, оборванная падением процесса, не проходит проверку и отбрасывается вместе со всем, что за ней
+class WriteAheadLog
+{
+public:
+    //Открывает журнал на дописывание, создавая файл при необходимости. Целые записи выдаются в records,
+    //повреждённый хвост отрезается. sync - сбрасывать каждую запись на диск (fsync), а не только в кэш ОС
+    WriteAheadLog(const std::string& path, bool sync, std::vector<WriteAheadLogRecord>* records = nullptr);
+    ~WriteAheadLog();
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    void AppendAdd(int document_id, std::string_view text, int status, const std::vector<int>& ratings);
+    void AppendRemove(int document_id);
+
+    //Сбрасывает всё записанное на диск (fsync), даже если журнал открыт без sync
+    void Sync();
+
+    const std::string& GetPath() const;
+
+private:
+    std::string path_;
+    bool sync_ = false;
+    std::FILE* file_ = nullptr;
+    std::string buffer_;
+
+    void Append(const std::string& payload);
+};